@@ -0,0 +1,152 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+// Fixed-capacity multi-producer multi-consumer queue. Pushing and popping claim ring cells with
+// atomic sequence numbers and never take a lock (Vyukov's bounded MPMC queue); the blocking
+// variants only sleep on a condition variable once the queue stays full or empty.
+template <typename T>
+class BoundedQueue
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool tryPush(const T& value)
+    {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = (std::ptrdiff_t)sequence - (std::ptrdiff_t)pos;
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    wake();
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;  // full
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& value)
+    {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = (std::ptrdiff_t)sequence - (std::ptrdiff_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = cell.value;
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    wake();
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;  // empty
+            }
+            else
+            {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // waits while the queue is full
+    void push(const T& value)
+    {
+        while (!tryPush(value))
+            sleep();
+    }
+
+    // waits while the queue is empty; false once it is closed and drained
+    bool pop(T& value)
+    {
+        while (!tryPop(value))
+        {
+            if (closed.load(std::memory_order_acquire))
+                return tryPop(value);
+            sleep();
+        }
+        return true;
+    }
+
+    // wake every waiting pop, which returns false from now on when nothing is left
+    void close()
+    {
+        closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(waitMutex);
+        waitCondition.notify_all();
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    void wake()
+    {
+        if (waiters.load(std::memory_order_acquire) > 0)
+        {
+            std::lock_guard<std::mutex> lock(waitMutex);
+            waitCondition.notify_all();
+        }
+    }
+
+    // the timeout covers a wake that slips in between a failed try and the wait
+    void sleep()
+    {
+        std::unique_lock<std::mutex> lock(waitMutex);
+        waiters.fetch_add(1, std::memory_order_acq_rel);
+        waitCondition.wait_for(lock, std::chrono::milliseconds(1));
+        waiters.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    std::atomic<size_t> enqueuePos{0};
+    std::atomic<size_t> dequeuePos{0};
+    std::atomic<bool> closed{false};
+    std::atomic<int> waiters{0};
+    std::mutex waitMutex;
+    std::condition_variable waitCondition;
+};
+
+#endif
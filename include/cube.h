@@ -1,26 +1,68 @@
 #ifndef CUBE_H
 #define CUBE_H
 
+#include <cstdint>
 #include <vector>
 #include <glm/glm.hpp>  // GLM for vector math
 
+// Subdivision levels of the precomputed cube meshes, coarsest first. Level 0 is the
+// plain 12-triangle cube, which is exact whenever the sphere morph is not active.
+const std::vector<int> CUBE_LOD_SUBDIVISIONS = {1, 2, 3, 5};
+
+// Maximum allowed deviation (in framebuffer pixels) between a tessellated cube and the
+// surface it approximates.
+const float CUBE_LOD_TOLERANCE = 0.5f;
+
+// Vertex layouts the cube mesh can be uploaded in
+enum class CubeVertexFormat {
+    FLOAT,   // 3 floats position + 3 floats normal, 24 bytes
+    PACKED   // PackedCubeVertex, 12 bytes
+};
+
+// Position as snorm16 relative to half the cube size (GL_SHORT, normalized) and normal as
+// GL_INT_2_10_10_10_REV (normalized). The cube vertices lie on a small regular lattice and
+// the normals are axis-aligned, so both are exact up to snorm16 rounding.
+struct PackedCubeVertex {
+    int16_t position[4];  // xyz + padding to keep the normal 4-byte aligned
+    uint32_t normal;
+};
+
 class Cube {
     public:
         Cube(int subdivisions, float size);
-        std::vector<glm::vec3> getPositions() { return positions; };
-        std::vector<uint32_t> getIndices() { return indices; };
-        std::vector<glm::vec3> getNormals() { return normals; };
-        std::vector<float> getInterleavedData();
+        const std::vector<glm::vec3>& getPositions() const { return positions; };
+        const std::vector<uint32_t>& getIndices() const { return indices; };
+        const std::vector<glm::vec3>& getNormals() const { return normals; };
+        const std::vector<float>& getInterleavedData() const { return interleaved; };  // position + normal per vertex, addressed by getIndices()
+        const std::vector<PackedCubeVertex>& getPackedData() const { return packed; };
+        float getPackedPositionScale() const { return 0.5f * mSize; };  // multiply unpacked positions by this
         size_t getNumVertices() const;
         size_t getNumIndices() const;
     private:
         void generateFace( const glm::vec3 &faceCenter, const glm::vec3 &uAxis, const glm::vec3 &vAxis );
         void generateCube();
+        void generateVertexData();
         int mSubdivisions;
-        int mSize;
+        float mSize;
         std::vector<glm::vec3> positions;
         std::vector<uint32_t> indices;
         std::vector<glm::vec3> normals;
+        std::vector<float> interleaved;
+        std::vector<PackedCubeVertex> packed;
 };
 
+// Pick the coarsest level of CUBE_LOD_SUBDIVISIONS that keeps the morph error below
+// CUBE_LOD_TOLERANCE for a cube covering projectedSize pixels.
+int selectCubeLod(float projectedSize, float sphereness);
+
+// Fraction of the vertex references in a triangle list that hit a FIFO post-transform
+// cache of the given size, i.e. that do not cause the vertex shader to run again.
+float vertexCacheHitRate(const std::vector<uint32_t>& indices, size_t cacheSize);
+
+// Triangle list with the faces of a rows x cols grid of unit cubes, where cube (x, y) is
+// centered at origin + (x, -y, 0). Coplanar faces of the grid are merged into one quad per
+// face orientation and grid line, which draws the same surface as the separate cubes.
+std::vector<glm::vec3> gridOutlineHull(const glm::vec3& origin, int cols, int rows);
+size_t gridOutlineHullVertices(int cols, int rows);
+
 #endif
@@ -0,0 +1,63 @@
+#ifndef FRAME_ENCODER_H
+#define FRAME_ENCODER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+
+// A read back frame waiting to be encoded, in OpenGL orientation (bottom row first)
+struct EncodeFrame {
+    std::vector<unsigned char> pixels;
+    int index = 0;
+    float time = 0.0f;
+    int repeats = 0;  // following frames that look the same, written from these pixels without rendering
+};
+
+// Pool of encoder threads fed by the render thread. Frames live in a fixed pool of buffers that
+// are handed out by acquire() and return to the pool once encoded, so when the encoders fall
+// behind acquire() blocks and the render loop slows down to their pace.
+class FrameEncoder
+{
+public:
+    using EncodeFunction = std::function<void(const EncodeFrame&)>;
+
+    // numThreads encoders sharing numBuffers buffers of frameBytes each
+    FrameEncoder(size_t frameBytes, unsigned int numThreads, unsigned int numBuffers, EncodeFunction encode);
+    ~FrameEncoder();
+
+    FrameEncoder(const FrameEncoder&) = delete;
+    FrameEncoder& operator=(const FrameEncoder&) = delete;
+
+    // a free frame buffer, waits while all of them are queued or being encoded
+    EncodeFrame* acquire();
+    // queue the frame for the encoders, the buffer must not be touched afterwards
+    void submit(EncodeFrame* frame);
+    // encode everything submitted so far and stop the threads
+    void finish();
+
+    unsigned int numThreads() const { return (unsigned int)workers.size(); }
+    // time the render thread spent waiting in acquire()
+    double waitSeconds() const { return waitTime; }
+    // summed encode time over all threads
+    double encodeSeconds() const { return encodeNs.load() * 1e-9; }
+    int framesEncoded() const { return encoded.load(); }
+
+private:
+    void work();
+
+    EncodeFunction encode;
+    std::vector<std::unique_ptr<EncodeFrame>> buffers;
+    BoundedQueue<EncodeFrame*> freeFrames;
+    BoundedQueue<EncodeFrame*> queuedFrames;
+    std::vector<std::thread> workers;
+    double waitTime = 0.0;
+    std::atomic<long long> encodeNs{0};
+    std::atomic<int> encoded{0};
+};
+
+#endif
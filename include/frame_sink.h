@@ -0,0 +1,173 @@
+#ifndef FRAME_SINK_H
+#define FRAME_SINK_H
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+#include "settings.h"
+#include "shm_ring.h"
+
+// Layout of the read back pixels a sink wants
+enum class PixelOrder {
+    BGR,    // OpenCV's order, 3 bytes per pixel with the bottom row first
+    RGB,    // the same in RGB order
+    YUV420  // I420 planes of BT.601 limited range Y'CbCr, top row first: Y, then U and V at half the
+            // width and height; converted on the GPU, so half the bytes of BGR are read back
+};
+
+// bytes of one frame read back in the given order
+inline size_t readbackBytes(PixelOrder order, unsigned int width, unsigned int height)
+{
+    return order == PixelOrder::YUV420 ? (size_t)width * height * 3 / 2 : (size_t)width * height * 3;
+}
+
+// One frame as read back, in the sink's PixelOrder. The pixels are only valid during
+// FrameSink::write, they may be a mapped pixel pack buffer.
+struct FrameView {
+    const unsigned char* pixels;
+    int index;
+    float time;
+};
+
+// Destination of the rendered frames
+class FrameSink
+{
+public:
+    FrameSink(unsigned int width, unsigned int height) : width(width), height(height) {}
+    virtual ~FrameSink() = default;
+
+    virtual PixelOrder pixelOrder() const { return PixelOrder::BGR; }
+    size_t frameBytes() const { return readbackBytes(pixelOrder(), width, height); }
+    // threads write() may be called from at once and out of order, 0 if it should be called on the
+    // render thread straight from the mapped readback memory
+    virtual unsigned int maxThreads() const = 0;
+    virtual void write(const FrameView& frame) = 0;
+    // frame index at time looks exactly like the frame just written from the same pixels; called on the
+    // same thread right after that write. Writes the pixels again unless the sink can refer to its output.
+    virtual void repeat(const FrameView& frame, int index, float time) { write({frame.pixels, index, time}); }
+    // memory of the sink the next frame can be read back into, which write() then hands on without a
+    // copy when frame.pixels points at it; nullptr if the sink has none or drops the frame
+    virtual unsigned char* frameMemory(int index) { return nullptr; }
+    // called after the last frame
+    virtual void finish() {}
+
+    virtual std::string description() const = 0;
+    size_t bytesWritten() const { return written.load(); }
+
+protected:
+    unsigned int width;
+    unsigned int height;
+    std::atomic<size_t> written{0};
+};
+
+// One image file per frame in settings.imageFormat, encoded on a pool of threads
+class ImageDirectorySink : public FrameSink
+{
+public:
+    ImageDirectorySink(unsigned int width, unsigned int height, const std::string& directory, unsigned int threads,
+                       ImageFormat format, int pngCompression, int pngStrips);
+    unsigned int maxThreads() const override { return threads; }
+    void write(const FrameView& frame) override;
+    // a hard link to the file of the frame
+    void repeat(const FrameView& frame, int index, float time) override;
+    std::string description() const override;
+
+private:
+    std::string filename(int index) const;
+
+    std::string directory;
+    unsigned int threads;
+    ImageFormat format;
+    int pngCompression;
+    int pngStrips;
+    std::atomic<int> files{0};
+};
+
+// A video container written by cv::VideoWriter on one thread; frame N is timestamped N / fps
+class VideoSink : public FrameSink
+{
+public:
+    VideoSink(unsigned int width, unsigned int height, const std::string& path, const std::string& codec, double fps);
+    bool isOpened() const { return writer.isOpened(); }
+    unsigned int maxThreads() const override { return 1; }
+    void write(const FrameView& frame) override;
+    // the flipped image of the last write goes to the writer again
+    void repeat(const FrameView& frame, int index, float time) override;
+    void finish() override;
+    std::string description() const override { return path; }
+
+private:
+    cv::Mat image;  // reused between frames
+    cv::VideoWriter writer;
+    std::string path;
+};
+
+// Headerless rgb24 frames, top row first, written straight from the readback memory
+class RawSink : public FrameSink
+{
+public:
+    RawSink(unsigned int width, unsigned int height, FILE* file, const std::string& name);
+    ~RawSink() override;
+    PixelOrder pixelOrder() const override { return PixelOrder::RGB; }
+    unsigned int maxThreads() const override { return 0; }
+    void write(const FrameView& frame) override;
+    void finish() override;
+    std::string description() const override { return name; }
+
+private:
+    FILE* file;
+    std::string name;
+    bool failed = false;  // a write came up short, later frames are dropped
+};
+
+// YUV4MPEG2 stream of 4:2:0 frames, as read by ffmpeg, x264 and most encoders from a pipe; the
+// planes come converted from the readback, so frames are written as they are
+class Y4mSink : public FrameSink
+{
+public:
+    Y4mSink(unsigned int width, unsigned int height, FILE* file, const std::string& name, double fps);
+    ~Y4mSink() override;
+    PixelOrder pixelOrder() const override { return PixelOrder::YUV420; }
+    unsigned int maxThreads() const override { return 0; }
+    void write(const FrameView& frame) override;
+    void finish() override;
+    std::string description() const override { return name; }
+
+private:
+    FILE* file;
+    std::string name;
+};
+
+// Slots of a shared memory ring, filled straight from the readback memory; the consumer reads
+// the frames in place (see tools/shm_consumer.cpp). Frames are dropped once no slot has been
+// released for timeoutSeconds, a renderer without a consumer would wait forever otherwise.
+class ShmSink : public FrameSink
+{
+public:
+    ShmSink(unsigned int width, unsigned int height, ShmRing* ring, const std::string& name, unsigned int timeoutSeconds);
+    unsigned int maxThreads() const override { return 0; }
+    void write(const FrameView& frame) override;
+    // the next free slot of the ring, published by the following write()
+    unsigned char* frameMemory(int index) override;
+    void finish() override;
+    std::string description() const override { return "shared memory " + name; }
+
+private:
+    // waits for a free slot; nullptr once the consumer timed out
+    unsigned char* nextSlot(int index);
+
+    std::unique_ptr<ShmRing> ring;
+    std::string name;
+    unsigned int timeoutSeconds;
+    bool abandoned = false;  // the consumer timed out, later frames are dropped
+    unsigned char* pendingSlot = nullptr;  // returned by frameMemory, not yet published
+};
+
+// The sink selected by the settings, nullptr after printing an error if it cannot be opened.
+// A sink on stdout takes over the process' standard output and moves all logging to stderr.
+std::unique_ptr<FrameSink> createFrameSink(const Settings& settings, double fps, unsigned int encoderThreads);
+
+#endif
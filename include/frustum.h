@@ -0,0 +1,44 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// View frustum as six inward-facing planes, extracted from a combined projection * view
+// matrix (Gribb & Hartmann)
+class Frustum
+{
+public:
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int side = 0; side < 2; ++side)
+            {
+                float sign = side == 0 ? 1.0f : -1.0f;
+                glm::vec4 plane;
+                for (int col = 0; col < 4; ++col)
+                    plane[col] = viewProjection[col][3] + sign * viewProjection[col][i];
+                planes[2 * i + side] = plane / glm::length(glm::vec3(plane.x, plane.y, plane.z));
+            }
+        }
+    }
+
+    // false only if the axis-aligned box lies entirely outside one of the planes
+    bool intersects(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+    {
+        for (const auto &plane : planes)
+        {
+            // corner of the box farthest along the plane normal
+            glm::vec3 p(plane.x >= 0.0f ? boxMax.x : boxMin.x,
+                        plane.y >= 0.0f ? boxMax.y : boxMin.y,
+                        plane.z >= 0.0f ? boxMax.z : boxMin.z);
+            if (plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    glm::vec4 planes[6];
+};
+#endif
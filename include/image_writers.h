@@ -0,0 +1,19 @@
+#ifndef IMAGE_WRITERS_H
+#define IMAGE_WRITERS_H
+
+#include <vector>
+
+// Encoders of the saved frames. They all take the pixels as read back: 3 bytes per pixel in BGR
+// order with the bottom row first, and append the complete file to out.
+
+// PNG of adaptively filtered rows, deflated at level (0-9) in strips of rows that are compressed
+// in parallel and joined into one zlib stream; one strip gives the same stream as a serial encoder
+void encodePng(const unsigned char* pixels, int width, int height, int level, int strips, std::vector<unsigned char>& out);
+
+// QOI ("Quite OK Image" format), a single linear pass without entropy coding
+void encodeQoi(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& out);
+
+// binary PPM (P6), the uncompressed pixels behind a short text header
+void encodePpm(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& out);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <string>
+
+// Filters of the compute pass that reduces the supersampled framebuffer to the output
+enum class DownsampleFilter {
+    BOX,     // average of the framebuffer pixels covered by an output pixel
+    LANCZOS  // Lanczos-3 over the three nearest output pixels in each direction
+};
+
+// Ways of anti-aliasing the cube passes
+enum class AntiAliasing {
+    SSAA,  // render at settings.supersampling times the output resolution and filter it down
+    MSAA,  // render multisampled at 1 or 2 times the output resolution and resolve the samples with a blit
+    ACCUMULATION  // average sub-pixel jittered passes at settings.supersampling times the output resolution
+};
+
+// Destinations of the saved frames
+enum class SinkType {
+    PNG,    // one image file per frame in a directory, PNG unless settings.imageFormat says otherwise
+    VIDEO,  // a video file written by OpenCV
+    RAW,    // headerless rgb24 frames
+    Y4M,    // YUV4MPEG2 stream
+    SHM     // ring buffer in shared memory, read in place by another process
+};
+
+// How channel planes whose cubes have all arrived are drawn
+enum class SettledPlanes {
+    SLABS,  // one ray-cast slab per plane
+    CUBES   // per cube, from the plane's pyramid level that fits settings.planeMipThreshold
+};
+
+// File formats of the png sink
+enum class ImageFormat {
+    PNG,  // deflated, smallest but slowest to encode
+    QOI,  // "Quite OK Image", run lengths and small deltas, encoded many times faster than PNG
+    PPM   // uncompressed binary PPM
+};
+
+// Render settings that can be changed per job on the command line, as --key=value
+struct Settings {
+    unsigned int outputWidth = 1920;   // size of the saved frames
+    unsigned int outputHeight = 1080;
+    unsigned int supersampling = 4;    // framebuffer pixels per output pixel along each axis; 1 or 2 with MSAA,
+                                       // which defaults to 1 like accumulation
+    AntiAliasing antiAliasing = AntiAliasing::SSAA;
+    unsigned int msaaSamples = 4;      // samples per framebuffer pixel with MSAA, 4 or 8
+    unsigned int accumulationPasses = 16;  // jittered passes averaged per frame with accumulation
+    float shutter = 0.0f;              // fraction of the frame interval the accumulation passes spread over,
+                                       // for motion blur
+    DownsampleFilter downsampleFilter = DownsampleFilter::BOX;
+    bool downsampleBenchmark = false;  // time every downsample path and compare their output each frame
+    std::string accumulationBenchmark; // with accumulation, raw rgb24 frames of the same frames rendered with SSAA,
+                                       // compared to the accumulated passes after 1, 2, 4, ... passes; empty for none
+    unsigned int startFrame = 0;       // first frame rendered
+    unsigned int frames = 0;           // frames rendered from startFrame on, 0 for the whole 40 s animation
+    unsigned int tileSize = 0;         // output pixels per side of the tiles the frame is rendered in, 0 renders
+                                       // the whole frame at once if it fits the maximum texture size
+    bool visibilityBuffer = true;      // shade every framebuffer pixel once from a visibility buffer where it is
+                                       // exact: flat-faced cubes without MSAA
+    SettledPlanes settledPlanes = SettledPlanes::SLABS;
+    bool outlineHulls = true;          // with cubes for settled planes, draw their outlines as one merged hull per plane
+    float planeMipThreshold = 1.0f;    // output pixels the merged cubes of a plane pyramid level may cover at most,
+                                       // 0 always draws the image cubes
+    float softRasterThreshold = 4.0f;  // framebuffer pixels below which cubes are splatted by a compute shader
+                                       // instead of drawn as impostors, 0 disables the software rasterizer
+    unsigned int encoderThreads = 0;   // threads encoding the saved frames, 0 uses all but one hardware thread
+    unsigned int encoderMemory = 2048; // MiB of frame buffers queued for the encoders; limits them below two per thread
+    SinkType sink = SinkType::PNG;
+    std::string sinkPath;              // directory, file or shared memory name of the sink, "-" for stdout;
+                                       // empty for its default
+    unsigned int shmTimeout = 60;      // seconds the shm sink waits for its consumer to release a slot before
+                                       // dropping frames
+    std::string videoCodec = "mp4v";   // FourCC of the video codec
+    ImageFormat imageFormat = ImageFormat::PNG;  // files written by the png sink
+    unsigned int pngCompression = 1;   // zlib level of the PNG files, 0-9; 0 stores the rows unfiltered and uncompressed
+    unsigned int pngStrips = 1;        // strips of rows of one PNG deflated in parallel
+};
+
+// Fill settings from the command line. Prints the usage and returns false on --help or on
+// an unknown option or invalid value.
+bool parseSettings(int argc, char** argv, Settings& settings);
+
+std::string downsampleFilterName(DownsampleFilter filter);
+std::string antiAliasingName(AntiAliasing antiAliasing);
+std::string sinkTypeName(SinkType sink);
+std::string imageFormatName(ImageFormat format);
+std::string settledPlanesName(SettledPlanes settledPlanes);
+
+#endif
@@ -13,33 +13,18 @@ class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly; defines are '#define' lines added to both
+    // stages, to build variants of the same source
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "")
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         try 
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode   = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            vertexCode   = addDefines(readSource(vertexPath), defines);
+            fragmentCode = addDefines(readSource(fragmentPath), defines);
         }
         catch (std::ifstream::failure& e)
         {
@@ -69,6 +54,30 @@ public:
         glDeleteShader(vertex);
         glDeleteShader(fragment);
     }
+    // constructor for a compute shader program
+    // ------------------------------------------------------------------------
+    explicit Shader(const char* computePath)
+    {
+        std::string computeCode;
+        try
+        {
+            computeCode = readSource(computePath);
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        }
+        const char* cShaderCode = computeCode.c_str();
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
+        ID = glCreateProgram();
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(compute);
+    }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
@@ -99,6 +108,10 @@ public:
     { 
         glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
     }
+    void setIVec2(const std::string &name, const glm::ivec2 &value) const
+    { 
+        glUniform2iv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
@@ -134,6 +147,44 @@ public:
     }
 
 private:
+    // insert defines right after the '#version' line, which has to stay first
+    // ------------------------------------------------------------------------
+    static std::string addDefines(const std::string &source, const std::string &defines)
+    {
+        if (defines.empty())
+            return source;
+        size_t versionEnd = source.find('\n') + 1;
+        return source.substr(0, versionEnd) + defines + "\n" + source.substr(versionEnd);
+    }
+    // read a shader file, replacing every '#include "file"' line by the contents of that
+    // file (relative to the including file) so shaders can share code
+    // ------------------------------------------------------------------------
+    static std::string readSource(const std::string &path)
+    {
+        std::ifstream shaderFile;
+        // ensure ifstream objects can throw exceptions:
+        shaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        shaderFile.open(path);
+        std::stringstream shaderStream;
+        shaderStream << shaderFile.rdbuf();
+        shaderFile.close();
+
+        const std::string dir = path.substr(0, path.find_last_of('/') + 1);
+        std::stringstream source;
+        std::string line;
+        while (std::getline(shaderStream, line))
+        {
+            if (line.rfind("#include", 0) == 0)
+            {
+                size_t first = line.find('"');
+                size_t last = line.rfind('"');
+                source << readSource(dir + line.substr(first + 1, last - first - 1)) << "\n";
+            }
+            else
+                source << line << "\n";
+        }
+        return source.str();
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type)
@@ -0,0 +1,70 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Ring of frame slots in POSIX shared memory, written by the renderer and read in place by a
+// consumer process. The write and read counters double as futex words, so a side that has to
+// wait for a slot or a frame sleeps in the kernel until the other side moves its counter.
+//
+// Layout: ShmRingHeader, then slotCount slots of ShmSlotHeader followed by frameBytes of pixels,
+// every slot starting on a 4 KiB boundary.
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t width;
+    uint32_t height;
+    uint32_t slotCount;
+    uint64_t frameBytes;
+    uint64_t slotBytes;  // stride between slots
+    std::atomic<uint32_t> written;  // frames published so far
+    std::atomic<uint32_t> read;     // frames released by the consumer so far
+    std::atomic<uint32_t> closed;   // set by the producer after its last frame
+};
+
+struct ShmSlotHeader {
+    int32_t index;
+    float time;
+};
+
+class ShmRing
+{
+public:
+    // create the shared memory object (name as for shm_open, e.g. "/convcubes") as the producer
+    static ShmRing* create(const std::string& name, uint32_t width, uint32_t height, uint64_t frameBytes, uint32_t slotCount);
+    // map an existing ring as the consumer, waiting up to timeoutSeconds for the producer to create it
+    static ShmRing* open(const std::string& name, double timeoutSeconds);
+    ~ShmRing();
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    const ShmRingHeader& info() const { return *header; }
+
+    // producer: pixels of the next free slot, waits while the consumer still holds every slot;
+    // nullptr if none is released within timeoutSeconds
+    unsigned char* beginWrite(double timeoutSeconds);
+    // producer: hand the slot returned by beginWrite to the consumer
+    void endWrite(int index, float time);
+    // producer: no more frames; wakes a waiting consumer
+    void close();
+
+    // consumer: the oldest unread frame, waits for the producer; nullptr once it closed the ring
+    const unsigned char* beginRead(ShmSlotHeader& slot);
+    // consumer: give the slot returned by beginRead back to the producer
+    void endRead();
+
+private:
+    ShmRing(const std::string& name, void* memory, size_t size, bool owner);
+    unsigned char* slot(uint32_t counter) const;
+
+    std::string name;
+    void* memory;
+    size_t size;
+    bool owner;  // the producer unlinks the object when done
+    ShmRingHeader* header;
+};
+
+#endif
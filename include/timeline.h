@@ -0,0 +1,35 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <utility>
+#include <vector>
+
+// Span of the timeline in which nothing that is drawn changes, start <= t < end
+struct StaticInterval {
+    float start;
+    float end;
+};
+
+// When the rendered image can change, gathered from the instance time tables. A still cube is
+// drawn from its time on, a transition cube only while it moves, so the image is the same at two
+// times when no still cube appears and no transition cube is drawn between them. The camera does
+// not move.
+class Timeline
+{
+public:
+    // a still cube appears at time and stays
+    void addStill(float time);
+    // a transition cube is drawn, and moves, for start <= t <= end
+    void addTransition(float start, float end);
+
+    // every time in [from, to] renders the same image
+    bool isStatic(float from, float to) const;
+    // the maximal static intervals overlapping [from, to), clipped to it
+    std::vector<StaticInterval> staticIntervals(float from, float to) const;
+
+private:
+    std::vector<float> stills;  // sorted, without duplicates
+    std::vector<std::pair<float, float>> transitions;  // union of the transition times as sorted, disjoint closed intervals
+};
+
+#endif
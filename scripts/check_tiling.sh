@@ -0,0 +1,50 @@
+#!/bin/bash
+# Renders the same frames once as a whole and once in tiles, and compares them byte for byte.
+# Tiles render an off-center part of the frame's frustum plus a cropped border, so the two must
+# be identical.
+#
+#   scripts/check_tiling.sh BUILD_DIR [TILE_SIZE] [renderer options...]
+#
+# The options are passed to both runs (default --output=640x360 --frames=60); both stream rgb24
+# frames to stdout, so nothing is written to disk. The default tile size of 100 divides neither
+# side of the default output, so the last column and row of tiles are partial.
+
+set -u
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 BUILD_DIR [TILE_SIZE] [renderer options...]" >&2
+    exit 2
+fi
+BUILD_DIR=$1
+TILE_SIZE=${2:-100}
+shift $(( $# >= 2 ? 2 : 1 ))
+OPTIONS=("$@")
+if [ ${#OPTIONS[@]} -eq 0 ]; then
+    OPTIONS=(--output=640x360 --frames=60)
+fi
+
+OUTPUT=640x360
+for option in "${OPTIONS[@]}"; do
+    case $option in --output=*) OUTPUT=${option#--output=} ;; esac
+done
+FRAME_BYTES=$(( 3 * ${OUTPUT%x*} * ${OUTPUT#*x} ))
+
+# the renderer finds its shaders and inputs relative to the build directory
+cd "$BUILD_DIR" || exit 2
+DIFFERENCE=$(cmp <(./ConvCubes "${OPTIONS[@]}" --sink=raw --sink-path=- 2>/dev/null) \
+                 <(./ConvCubes "${OPTIONS[@]}" --sink=raw --sink-path=- --tile-size="$TILE_SIZE" 2>/dev/null))
+STATUS=$?
+if [ $STATUS -eq 0 ]; then
+    echo "Tiled frames ($TILE_SIZE px tiles) are identical to the whole frames"
+    exit 0
+fi
+if [[ $DIFFERENCE =~ (byte|char)\ ([0-9]+) ]]; then
+    OFFSET=$(( ${BASH_REMATCH[2]} - 1 ))
+    PIXEL=$(( OFFSET % FRAME_BYTES / 3 ))
+    WIDTH=${OUTPUT%x*}
+    # rows are written top row first
+    echo "Tiled frames differ: frame $(( OFFSET / FRAME_BYTES )), pixel $(( PIXEL % WIDTH )),$(( PIXEL / WIDTH )) from the top left"
+else
+    echo "Tiled frames differ: $DIFFERENCE"
+fi
+exit 1
@@ -0,0 +1,70 @@
+#!/bin/bash
+# Renders the same frames once per set of options and prints the mean GPU times per frame and the
+# render target memory the renderer reports, for A/B comparisons of rendering paths.
+#
+#   scripts/compare_frame_times.sh BUILD_DIR [--frames=N] [--start-frame=N] [--llvmpipe] OPTIONS...
+#
+# Every OPTIONS argument is one quoted set of renderer options, e.g.
+#
+#   scripts/compare_frame_times.sh build --start-frame=600 "--output=3840x2160 --visibility-buffer=off" \
+#       "--output=3840x2160 --visibility-buffer=on"
+#
+# or the anti-aliasing modes against the 4x4 supersampled framebuffer:
+#
+#   scripts/compare_frame_times.sh build "--aa=ssaa" "--aa=msaa --msaa-samples=4" \
+#       "--aa=msaa --msaa-samples=8 --supersampling=2" "--aa=accumulation --accumulation-passes=16"
+#
+# --llvmpipe runs the renderer on Mesa's software rasterizer, which needs no GPU; the soft raster
+# threshold sweep of the compute splatting path, for instance:
+#
+#   scripts/compare_frame_times.sh build --llvmpipe "--output=640x360 --soft-raster-threshold=0" \
+#       "--output=640x360 --soft-raster-threshold=2" "--output=640x360 --soft-raster-threshold=4" \
+#       "--output=640x360 --soft-raster-threshold=8"
+#
+# The frames go to /dev/null as rgb24, so encoding and disk do not count. The first two reported
+# frames are left out of the means, they include shader compilation and first-use allocations.
+
+set -u
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 BUILD_DIR [--frames=N] [--start-frame=N] [--llvmpipe] OPTIONS..." >&2
+    exit 2
+fi
+BUILD_DIR=$1
+shift
+FRAMES=--frames=30
+START=--start-frame=600
+while [ $# -gt 0 ]; do
+    case $1 in
+        --frames=*) FRAMES=$1; shift ;;
+        --start-frame=*) START=$1; shift ;;
+        --llvmpipe) export LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe; shift ;;
+        *) break ;;
+    esac
+done
+
+cd "$BUILD_DIR" || exit 2
+FIRST=1
+printf "%-60s %12s %15s %15s %12s\n" "options" "tCubes ms" "tDownsample ms" "tSoftRaster ms" "targets MiB"
+for options in "$@"; do
+    # options are split on spaces on purpose
+    # shellcheck disable=SC2086
+    OUTPUT=$(./ConvCubes $options "$START" "$FRAMES" --sink=raw --sink-path=/dev/null 2>&1)
+    if [ $FIRST -eq 1 ]; then
+        # the driver the times were taken on
+        grep -m1 "^OpenGL renderer:" <<< "$OUTPUT" >&2
+        FIRST=0
+    fi
+    awk -v options="$options" '
+        /^Render targets:/ { targets = $3 }
+        /^GPU times of frame/ { frame++ }
+        frame > 2 && /^tCubes:/ { cubes += $2 }
+        frame > 2 && /^tDownsample:/ { downsample += $2 }
+        frame > 2 && /^tSoftRaster:/ { softRaster += $2 }
+        END {
+            n = frame > 2 ? frame - 2 : 0
+            if (n == 0) { printf "%-60s no GPU times reported\n", options; exit 1 }
+            printf "%-60s %12.3f %15.3f %15.3f %12.1f\n", options, 1000 * cubes / n, 1000 * downsample / n,
+                1000 * softRaster / n, targets
+        }' <<< "$OUTPUT"
+done
@@ -1,22 +1,29 @@
 #version 330 core
+#ifdef VISIBILITY_BUFFER
+out uint oVisibility;
+#else
 out vec4 oColor;
+#endif
 
 in vec4 fColor;
 in vec3 fNormal;
+flat in int fInstanceID;
 
 uniform bool isOutline;
+uniform bool isStill;
+
+#include "shading.glsl"
+#include "visibility.glsl"
 
 void main()
 {
+#ifdef VISIBILITY_BUFFER
+    oVisibility = packVisibility(fInstanceID, isStill, isOutline, fNormal);
+#else
     if (isOutline) {
         oColor = vec4(1.0);
     } else {
-        vec3 normal = normalize( -fNormal );
-        vec3 diffLight = normalize(vec3( 1, 0, -1 ));
-        float diffuse = max( dot( normal, diffLight ), 0 );
-        float w_diff = 0.9;
-        float w_amb = 0.1;
-        vec3 rgbColor = vec3(fColor.x, fColor.y, fColor.z);
-        oColor = vec4(w_amb * rgbColor + w_diff * rgbColor * diffuse, fColor.w);
+        oColor = shadeCube(fColor, fNormal);
     }
+#endif
 }
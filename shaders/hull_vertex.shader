@@ -0,0 +1,21 @@
+#version 460 core
+layout (location = 0) in vec3 aPos;
+
+// Uniforms
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// Outs
+out vec4 fColor;
+out vec3 fNormal;
+flat out int fInstanceID;
+
+void main()
+{
+    // Merged outline faces of a settled plane, already in world space
+    fColor = vec4(1.0);
+    fNormal = vec3(0);
+    fInstanceID = 0;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
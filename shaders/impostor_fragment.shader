@@ -0,0 +1,51 @@
+#version 460 core
+#ifdef VISIBILITY_BUFFER
+out uint oVisibility;
+#else
+out vec4 oColor;
+#endif
+
+flat in vec4 fColor;
+flat in vec3 fCenter;
+flat in float fHalfSize;
+flat in int fInstanceID;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 invViewProjection;
+uniform vec2 viewportSize;
+uniform vec3 cameraPos;
+uniform bool isOutline;
+uniform bool isStill;
+
+#include "shading.glsl"
+#include "visibility.glsl"
+
+void main()
+{
+    // Ray from the camera through this pixel
+    vec2 ndc = gl_FragCoord.xy / viewportSize * 2.0 - 1.0;
+    vec4 farPoint = invViewProjection * vec4(ndc, 1.0, 1.0);
+    vec3 rayDir = normalize(farPoint.xyz / farPoint.w - cameraPos);
+
+    float tNear, tFar;
+    if (!intersectBox(cameraPos, rayDir, fCenter - fHalfSize, fCenter + fHalfSize, tNear, tFar)) discard;
+
+    // The outline pass draws the back faces of the cube, the colored pass the front faces
+    float tHit = isOutline ? tFar : tNear;
+    vec3 hitPos = cameraPos + tHit * rayDir;
+
+    vec4 clipPos = projection * view * vec4(hitPos, 1.0);
+    gl_FragDepth = (clipPos.z / clipPos.w) * 0.5 + 0.5;
+
+#ifdef VISIBILITY_BUFFER
+    oVisibility = packVisibility(fInstanceID, isStill, isOutline, boxFaceNormal(hitPos - fCenter));
+#else
+    if (isOutline) {
+        oColor = vec4(1.0);
+    } else {
+        // Face normal of the hit point
+        oColor = shadeCube(fColor, boxFaceNormal(hitPos - fCenter));
+    }
+#endif
+}
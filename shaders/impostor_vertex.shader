@@ -0,0 +1,56 @@
+#version 460 core
+
+#include "instance.glsl"
+
+// Uniforms
+uniform mat4 view;
+uniform mat4 projection;
+uniform float currentTime;
+uniform bool isStill;
+uniform bool isOutline;
+uniform float impostorThreshold;  // only cubes smaller than this many pixels are drawn as impostors
+uniform float softRasterThreshold;  // cubes smaller than this many pixels are splatted by the software rasterizer
+uniform vec2 viewportSize;
+uniform bool culledInstances;  // draw through the occlusion-culled instance list
+uniform float cubeSize;  // edge length of the drawn cubes
+
+// Outs
+flat out vec4 fColor;
+flat out vec3 fCenter;
+flat out float fHalfSize;
+flat out int fInstanceID;
+
+void main()
+{
+    int instanceID = drawnInstance(gl_BaseInstance + gl_InstanceID, culledInstances);
+
+    vec3 aOffset;
+    vec4 aColor;
+    bool visible = fetchInstance(instanceID, isStill, currentTime, aOffset, aColor);
+
+    float aScale = cubeSize;
+    if (!isOutline) aScale *= 0.8;
+
+    fColor = aColor;
+    fCenter = aOffset;
+    fHalfSize = 0.5 * aScale;
+    fInstanceID = instanceID;
+
+    float size = projectedCubeSize(aOffset, cubeSize, view, projection, viewportSize.y);
+    if (!visible || size >= impostorThreshold || size < softRasterThreshold) {
+        gl_Position = CULLED_POSITION;
+        return;
+    }
+
+    // Every instance is a screen-aligned quad of 4 strip vertices. Unlike a point sprite, which is
+    // dropped as soon as its center leaves the clip volume, the quad is clipped per pixel, so cubes
+    // straddling the frame or tile edge stay visible. It has to cover the bounding sphere of the box
+    // (diagonal sqrt(3)), plus a pixel of margin for the perspective stretch away from the view axis
+    float spriteSize = ceil(aScale / cubeSize * sqrt(3.0) * size) + 2.0;
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    // counter-clockwise, so the quad survives the back-face culling of the colored pass; mirrored
+    // for the outline pass, which culls front faces
+    if (isOutline) corner.x = -corner.x;
+    gl_Position = projection * view * vec4(aOffset, 1.0);
+    gl_Position.xy += corner * spriteSize / viewportSize * gl_Position.w;
+}
@@ -0,0 +1,118 @@
+// Instance buffers and cube placement shared by every pass that draws cubes
+
+#define TRANS_KEYFRAMES 170
+
+struct InstanceDataStill {
+    float color[4];
+    float position[3];
+    float time;
+};
+
+struct InstanceDataTrans {
+    float maxDuration;
+    int easing;
+    int keyframeCount;
+    float startTimes[TRANS_KEYFRAMES];
+    int endIdxs[TRANS_KEYFRAMES];
+};
+
+// Now define the buffer block
+layout(std430, binding = 2) buffer InstanceBufferStill {
+    InstanceDataStill instancesStill[];
+};
+
+layout(std430, binding = 3) buffer InstanceBufferTrans {
+    InstanceDataTrans instancesTrans[];
+};
+
+// A channel plane: cube (x, y) of the plane is instance firstInstance + y * cols + x,
+// located at origin + (x, -y, 0)
+struct PlaneData {
+    float origin[3];
+    int cols;
+    int rows;
+    int firstInstance;
+};
+
+layout(std430, binding = 4) buffer PlaneBuffer {
+    PlaneData planes[];
+};
+
+// Instances that survived occlusion culling, in segments starting at the base instance of
+// each indirect draw
+layout(std430, binding = 5) buffer VisibleInstanceBuffer {
+    int visibleInstances[];
+};
+
+// Instance a draw refers to with gl_BaseInstance + gl_InstanceID
+int drawnInstance(int drawIndex, bool culled)
+{
+    return culled ? visibleInstances[drawIndex] : drawIndex;
+}
+
+float applyEasing(float t, int easingType) {
+    switch (easingType) {
+        case 0: return t; // LINEAR
+        case 1: return t * t; // IN_QUAD
+        case 2: return 1.0 - (1.0 - t) * (1.0 - t); // OUT_QUAD
+        case 3: return t < 0.5 ? 2.0 * t * t : 1.0 - 2.0 * (1.0 - t) * (1.0 - t); // IN_OUT_QUAD
+        case 4: return t * t * t; // IN_CUBIC
+        case 5: return 1.0 - pow(1.0 - t, 3.0); // OUT_CUBIC
+        case 6: return t < 0.5 ? 4.0 * t * t * t : 1.0 - pow(1.0 - 2.0 * t, 3.0); // IN_OUT_CUBIC
+        case 7: return 0; // Hold
+        default: return t; // Default to linear
+    }
+}
+
+// Position and color of a still or transition cube at the given time. Returns false if the
+// cube is not visible at that time.
+bool fetchInstance(int instanceID, bool still, float time, out vec3 aOffset, out vec4 aColor)
+{
+    aOffset = vec3(0, 0, -999999);  // Default values
+    aColor = vec4(0, 0, 0, 0);
+    if (still) {
+        InstanceDataStill stillInstance = instancesStill[instanceID];
+        if (time >= stillInstance.time) {
+            aOffset = vec3(stillInstance.position[0], stillInstance.position[1], stillInstance.position[2]);
+            aColor = vec4(stillInstance.color[0], stillInstance.color[1], stillInstance.color[2], stillInstance.color[3]);
+            return true;
+        }
+    } else {
+        InstanceDataStill startInstance = instancesStill[instanceID];
+        InstanceDataTrans transInstance = instancesTrans[instanceID];
+        float transMaxDuration = transInstance.maxDuration;
+        int easing = transInstance.easing;
+        for (int i = 0; i < transInstance.keyframeCount; i++) {
+            int endIdx = transInstance.endIdxs[i];
+            InstanceDataStill endInstance = instancesStill[endIdx];
+
+            float t0 = transInstance.startTimes[i];
+            float t1 = endInstance.time;
+            if (t0 <= time && time <= t1) {
+                //float duration = min(t1 - t0, transMaxDuration);
+                float t = (time - t0) / (t1 - t0);
+                t = applyEasing(t, easing);
+
+                vec3 p0 = vec3(startInstance.position[0], startInstance.position[1], startInstance.position[2]);
+                vec3 p1 = vec3(endInstance.position[0], endInstance.position[1], endInstance.position[2]);
+                aOffset = mix(p0, p1, t);
+
+                vec4 c0 = vec4(startInstance.color[0], startInstance.color[1], startInstance.color[2], startInstance.color[3]);
+                vec4 c1 = vec4(endInstance.color[0], endInstance.color[1], endInstance.color[2], endInstance.color[3]);
+                aColor = mix(c0, c1, t);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Size in pixels of a cube of the given edge length centered at worldPos
+float projectedCubeSize(vec3 worldPos, float size, mat4 view, mat4 projection, float viewportHeight)
+{
+    float depth = max(-(view * vec4(worldPos, 1.0)).z, 0.1);
+    return size * projection[1][1] * 0.5 * viewportHeight / depth;
+}
+
+// Clip-space position that lies outside the view volume, used to drop a vertex or point
+const vec4 CULLED_POSITION = vec4(2.0, 2.0, 2.0, 1.0);
@@ -0,0 +1,36 @@
+// Lighting of the colored cubes, shared by every pass that shades them
+
+vec4 shadeCube(vec4 fColor, vec3 fNormal)
+{
+    vec3 normal = normalize( -fNormal );
+    vec3 diffLight = normalize(vec3( 1, 0, -1 ));
+    float diffuse = max( dot( normal, diffLight ), 0 );
+    float w_diff = 0.9;
+    float w_amb = 0.1;
+    vec3 rgbColor = vec3(fColor.x, fColor.y, fColor.z);
+    return vec4(w_amb * rgbColor + w_diff * rgbColor * diffuse, fColor.w);
+}
+
+// Axis-aligned normal of the face of a box that contains the given point, relative to
+// the box center
+vec3 boxFaceNormal(vec3 local)
+{
+    vec3 a = abs(local);
+    return a.x > a.y && a.x > a.z ? vec3(sign(local.x), 0, 0)
+         : a.y > a.z ? vec3(0, sign(local.y), 0)
+         : vec3(0, 0, sign(local.z));
+}
+
+// Slab test of a ray against an axis-aligned box; tNear and tFar are the ray parameters of
+// the entry and exit points
+bool intersectBox(vec3 origin, vec3 dir, vec3 boxMin, vec3 boxMax, out float tNear, out float tFar)
+{
+    vec3 invDir = 1.0 / dir;
+    vec3 t0 = (boxMin - origin) * invDir;
+    vec3 t1 = (boxMax - origin) * invDir;
+    vec3 tMin = min(t0, t1);
+    vec3 tMax = max(t0, t1);
+    tNear = max(max(tMin.x, tMin.y), tMin.z);
+    tFar = min(min(tMax.x, tMax.y), tMax.z);
+    return tNear <= tFar && tFar >= 0.0;
+}
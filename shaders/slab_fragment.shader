@@ -0,0 +1,61 @@
+#version 460 core
+#ifdef VISIBILITY_BUFFER
+out uint oVisibility;
+#else
+out vec4 oColor;
+#endif
+
+flat in int fPlaneID;
+in vec3 fWorldPos;
+
+#include "instance.glsl"
+#include "shading.glsl"
+#include "visibility.glsl"
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 cameraPos;
+
+void main()
+{
+    PlaneData plane = planes[fPlaneID];
+    vec3 origin = vec3(plane.origin[0], plane.origin[1], plane.origin[2]);
+
+    // Plane-local coordinates in which cell (x, y) spans [x, x+1] x [y, y+1] x [-0.5, 0.5];
+    // rows run towards -y in world space
+    vec3 rayDir = normalize(fWorldPos - cameraPos);
+    vec3 dir = vec3(rayDir.x, -rayDir.y, rayDir.z);
+    vec3 entry = vec3(fWorldPos.x - origin.x + 0.5, origin.y - fWorldPos.y + 0.5, fWorldPos.z - origin.z);
+
+    // The cell the ray enters the slab through. Per-cube rendering shows the colored inner
+    // cube of that cell if the ray hits it, and otherwise the white back face of the cell's
+    // outline cube where the ray leaves it; cubes of other cells lie behind that face.
+    ivec2 cell = clamp(ivec2(floor(entry.xy + 1e-3 * dir.xy)), ivec2(0), ivec2(plane.cols - 1, plane.rows - 1));
+    vec3 cellMin = vec3(cell, -0.5);
+    vec3 cellMax = vec3(cell + 1, 0.5);
+    vec3 cellCenter = 0.5 * (cellMin + cellMax);
+
+    float tNear, tFar, tExitCell;
+    intersectBox(entry, dir, cellMin, cellMax, tNear, tExitCell);
+    bool innerHit = intersectBox(entry, dir, cellCenter - 0.4, cellCenter + 0.4, tNear, tFar);
+    float tHit = innerHit ? max(tNear, 0.0) : max(tExitCell, 0.0);
+
+    vec3 hitPos = fWorldPos + tHit * rayDir;
+    vec4 clipPos = projection * view * vec4(hitPos, 1.0);
+    gl_FragDepth = (clipPos.z / clipPos.w) * 0.5 + 0.5;
+
+    int cellInstance = plane.firstInstance + cell.y * plane.cols + cell.x;
+#ifdef VISIBILITY_BUFFER
+    vec3 cellNormal = innerHit ? boxFaceNormal(entry + tHit * dir - cellCenter) : vec3(0, 0, 1);
+    oVisibility = packVisibility(cellInstance, true, !innerHit, vec3(cellNormal.x, -cellNormal.y, cellNormal.z));
+#else
+    if (!innerHit) {
+        oColor = vec4(1.0);
+    } else {
+        InstanceDataStill cube = instancesStill[cellInstance];
+        vec4 color = vec4(cube.color[0], cube.color[1], cube.color[2], cube.color[3]);
+        vec3 localNormal = boxFaceNormal(entry + tHit * dir - cellCenter);
+        oColor = shadeCube(color, vec3(localNormal.x, -localNormal.y, localNormal.z));
+    }
+#endif
+}
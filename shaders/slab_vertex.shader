@@ -0,0 +1,29 @@
+#version 460 core
+layout (location = 0) in vec3 aPos;
+
+#include "instance.glsl"
+
+// Uniforms
+uniform mat4 view;
+uniform mat4 projection;
+uniform float positionScale;  // scale of the (possibly snorm-packed) mesh positions
+
+// Outs
+flat out int fPlaneID;
+out vec3 fWorldPos;
+
+void main()
+{
+    // One instance per settled plane; the unit cube is stretched over the whole plane
+    int planeID = gl_BaseInstance + gl_InstanceID;
+    PlaneData plane = planes[planeID];
+
+    vec3 origin = vec3(plane.origin[0], plane.origin[1], plane.origin[2]);
+    vec3 size = vec3(plane.cols, plane.rows, 1.0);
+    vec3 center = origin + vec3(0.5 * (plane.cols - 1), -0.5 * (plane.rows - 1), 0.0);
+    vec3 pos = center + aPos * positionScale * size;
+
+    fPlaneID = planeID;
+    fWorldPos = pos;
+    gl_Position = projection * view * vec4(pos, 1.0);
+}
@@ -0,0 +1,25 @@
+// Software-rasterized framebuffer: two uints per pixel, the view depth as float bits and the RGBA8
+// color. A depth pass keeps the nearest cube with atomicMin on the depth, which orders positive
+// floats like uints; a color pass then writes the color of the splat whose depth was kept.
+
+layout(std430, binding = 9) buffer SoftRasterBuffer {
+    uint softRasterPixels[];  // depth and color of pixel i at 2i and 2i+1
+};
+
+// Value the buffer is cleared to; its bits are a NaN, above every depth a splat can produce
+const uint SOFT_RASTER_EMPTY = 0xFFFFFFFFu;
+
+uint packSoftRasterDepth(float viewDepth)
+{
+    return floatBitsToUint(max(viewDepth, 0.0));
+}
+
+float softRasterViewDepth(uint depth)
+{
+    return uintBitsToFloat(depth);
+}
+
+vec3 softRasterColor(uint color)
+{
+    return unpackUnorm4x8(color).rgb;
+}
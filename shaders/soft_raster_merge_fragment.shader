@@ -0,0 +1,22 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+#include "soft_raster.glsl"
+
+uniform mat4 projection;
+uniform vec2 viewportSize;
+
+void main()
+{
+    // Depth-test the splatted cubes against the hardware-rasterized ones
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    int pixelIndex = 2 * (pixel.y * int(viewportSize.x) + pixel.x);
+    uint depth = softRasterPixels[pixelIndex];
+    if (depth == SOFT_RASTER_EMPTY) discard;
+
+    vec4 clipPos = projection * vec4(0.0, 0.0, -softRasterViewDepth(depth), 1.0);
+    gl_FragDepth = (clipPos.z / clipPos.w) * 0.5 + 0.5;
+    FragColor = vec4(softRasterColor(softRasterPixels[pixelIndex + 1]), 1.0);
+}
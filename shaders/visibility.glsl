@@ -0,0 +1,32 @@
+// Visibility buffer texels: what covers a pixel, shaded later by one full-screen resolve pass.
+// Bits 0-26 hold the instance ID + 1 (0 is the background), bits 27-29 the face of the cube
+// and bits 30 and 31 whether it is an outline and whether it is a transition cube.
+
+const uint VIS_ID_MASK = 0x07FFFFFFu;
+const uint VIS_FACE_SHIFT = 27u;
+const uint VIS_OUTLINE = 1u << 30;
+const uint VIS_TRANSITION = 1u << 31;
+
+// Face index 2 * axis + (1 if facing the negative axis direction) of an axis-aligned normal
+uint faceIndex(vec3 normal)
+{
+    vec3 a = abs(normal);
+    uint axis = a.x > a.y && a.x > a.z ? 0u : a.y > a.z ? 1u : 2u;
+    return 2u * axis + (normal[axis] < 0.0 ? 1u : 0u);
+}
+
+vec3 faceNormal(uint face)
+{
+    vec3 normal = vec3(0);
+    normal[face / 2u] = (face & 1u) == 0u ? 1.0 : -1.0;
+    return normal;
+}
+
+uint packVisibility(int instanceID, bool isStill, bool isOutline, vec3 normal)
+{
+    uint texel = (uint(instanceID) + 1u) & VIS_ID_MASK;
+    texel |= faceIndex(normal) << VIS_FACE_SHIFT;
+    if (isOutline) texel |= VIS_OUTLINE;
+    if (!isStill) texel |= VIS_TRANSITION;
+    return texel;
+}
@@ -0,0 +1,33 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+#include "instance.glsl"
+#include "shading.glsl"
+#include "visibility.glsl"
+
+uniform usampler2D visibility;
+uniform float currentTime;
+uniform vec4 backgroundColor;
+
+void main()
+{
+    // Shade the one cube face that covers this pixel
+    uint texel = texelFetch(visibility, ivec2(gl_FragCoord.xy), 0).r;
+    if (texel == 0u) {
+        FragColor = backgroundColor;
+        return;
+    }
+    if ((texel & VIS_OUTLINE) != 0u) {
+        FragColor = vec4(1.0);
+        return;
+    }
+
+    int instanceID = int(texel & VIS_ID_MASK) - 1;
+    bool isStill = (texel & VIS_TRANSITION) == 0u;
+    vec3 aOffset;
+    vec4 aColor;
+    fetchInstance(instanceID, isStill, currentTime, aOffset, aColor);
+    FragColor = shadeCube(aColor, faceNormal((texel >> VIS_FACE_SHIFT) & 7u));
+}
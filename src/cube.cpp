@@ -1,26 +1,39 @@
+#include <algorithm>
+#include <deque>
 #include <iostream>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include "cube.h"
 
 Cube::Cube(int subdivisions, float size): mSubdivisions(subdivisions), mSize(size) {
     generateCube();
+    generateVertexData();
 }
 
-std::vector<float> Cube::getInterleavedData() {
-    std::vector<float> data;
+void Cube::generateVertexData() {
+    interleaved.reserve(6 * positions.size());
+    packed.reserve(positions.size());
 
-    for (auto idx: indices) {
+    const float invScale = 1.0f / getPackedPositionScale();
+    for (size_t idx = 0; idx < positions.size(); ++idx) {
         auto p = positions[idx];
         auto n = normals[idx];
-        data.push_back(p.x);
-        data.push_back(p.y);
-        data.push_back(p.z);
-        data.push_back(n.x);
-        data.push_back(n.y);
-        data.push_back(n.z);
+        interleaved.push_back(p.x);
+        interleaved.push_back(p.y);
+        interleaved.push_back(p.z);
+        interleaved.push_back(n.x);
+        interleaved.push_back(n.y);
+        interleaved.push_back(n.z);
+
+        PackedCubeVertex v;
+        v.position[0] = (int16_t)glm::packSnorm1x16(p.x * invScale);
+        v.position[1] = (int16_t)glm::packSnorm1x16(p.y * invScale);
+        v.position[2] = (int16_t)glm::packSnorm1x16(p.z * invScale);
+        v.position[3] = 0;
+        v.normal = glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f));
+        packed.push_back(v);
     }
-
-    return data;
 }
 
 void Cube::generateFace( const glm::vec3 &faceCenter, const glm::vec3 &uAxis, const glm::vec3 &vAxis )
@@ -42,8 +55,11 @@ void Cube::generateFace( const glm::vec3 &faceCenter, const glm::vec3 &uAxis, co
 
     // 'baseIdx' will correspond to the index of the first vertex we created in this call to generateFace()
 //    const uint32_t baseIdx = indices->empty() ? 0 : ( indices->back() + 1 );
-    for( int u = 0; u < mSubdivisions; u++ ) {
-        for( int v = 0; v < mSubdivisions; v++ ) {
+    // walk the quads row by row, in the same order the vertices were laid out: every row
+    // only introduces the mSubdivisions + 1 vertices of its upper edge, while its lower edge
+    // was transformed by the previous row and is still in the post-transform cache
+    for( int v = 0; v < mSubdivisions; v++ ) {
+        for( int u = 0; u < mSubdivisions; u++ ) {
             const int i = u + v * ( mSubdivisions + 1 );
 
             indices.push_back( baseIdx + i );
@@ -96,3 +112,92 @@ void Cube::generateCube()
     // -Z
     generateFace( glm::vec3(0,0,-sz.z), glm::vec3(sz.x,0,0), glm::vec3(0,sz.y,0) );
 }
+
+int selectCubeLod(float projectedSize, float sphereness)
+{
+    // Without morph every face is flat, so the single-quad faces are exact at any size
+    if( sphereness <= 0.0f )
+        return 0;
+
+    // A face split into n segments approximates a quarter arc of the morphed sphere; the
+    // chord error of each segment is r * (1 - cos(pi / 4n)), scaled by the morph amount.
+    const float radius = 0.5f * projectedSize;
+    for( size_t level = 0; level < CUBE_LOD_SUBDIVISIONS.size(); level++ ) {
+        const int n = CUBE_LOD_SUBDIVISIONS[level];
+        const float error = sphereness * radius * ( 1.0f - glm::cos( glm::pi<float>() / ( 4.0f * n ) ) );
+        if( error <= CUBE_LOD_TOLERANCE )
+            return (int)level;
+    }
+    return (int)CUBE_LOD_SUBDIVISIONS.size() - 1;
+}
+
+float vertexCacheHitRate(const std::vector<uint32_t>& indices, size_t cacheSize)
+{
+    if( indices.empty() )
+        return 0.0f;
+
+    std::deque<uint32_t> cache;
+    size_t hits = 0;
+    for( auto idx : indices ) {
+        if( std::find( cache.begin(), cache.end(), idx ) != cache.end() ) {
+            hits++;
+            continue;
+        }
+        cache.push_back( idx );
+        if( cache.size() > cacheSize )
+            cache.pop_front();
+    }
+    return hits / float( indices.size() );
+}
+
+// Quad c, c + a, c + a + b, c + b, front facing towards cross(a, b)
+static void addQuad( std::vector<glm::vec3>& vertices, const glm::vec3& c, const glm::vec3& a, const glm::vec3& b )
+{
+    vertices.push_back( c );
+    vertices.push_back( c + a );
+    vertices.push_back( c + a + b );
+
+    vertices.push_back( c );
+    vertices.push_back( c + a + b );
+    vertices.push_back( c + b );
+}
+
+size_t gridOutlineHullVertices(int cols, int rows)
+{
+    // both orientations on every inner grid line, one on the borders, plus front and back
+    return 6 * ( 2 * cols + 2 * rows + 2 );
+}
+
+std::vector<glm::vec3> gridOutlineHull(const glm::vec3& origin, int cols, int rows)
+{
+    std::vector<glm::vec3> vertices;
+    vertices.reserve( gridOutlineHullVertices( cols, rows ) );
+
+    // corner with the lowest coordinates; rows run towards -y
+    const glm::vec3 lo = origin + glm::vec3( -0.5f, 0.5f - rows, -0.5f );
+    const glm::vec3 dx( cols, 0, 0 );
+    const glm::vec3 dy( 0, rows, 0 );
+    const glm::vec3 dz( 0, 0, 1 );
+
+    // Faces between columns k - 1 and k: +X of the left cube, -X of the right cube
+    for( int k = 0; k <= cols; k++ ) {
+        const glm::vec3 c = lo + glm::vec3( k, 0, 0 );
+        if( k > 0 )
+            addQuad( vertices, c, dy, dz );
+        if( k < cols )
+            addQuad( vertices, c, dz, dy );
+    }
+    // Faces between rows k - 1 and k: -Y of the upper cube, +Y of the lower cube
+    for( int k = 0; k <= rows; k++ ) {
+        const glm::vec3 c = lo + glm::vec3( 0, rows - k, 0 );
+        if( k > 0 )
+            addQuad( vertices, c, dx, dz );
+        if( k < rows )
+            addQuad( vertices, c, dz, dx );
+    }
+    // +Z and -Z
+    addQuad( vertices, lo + dz, dx, dy );
+    addQuad( vertices, lo, dy, dx );
+
+    return vertices;
+}
@@ -0,0 +1,56 @@
+#include "frame_encoder.h"
+
+#include <chrono>
+
+FrameEncoder::FrameEncoder(size_t frameBytes, unsigned int numThreads, unsigned int numBuffers, EncodeFunction encode)
+    : encode(std::move(encode)), freeFrames(numBuffers), queuedFrames(numBuffers)
+{
+    for (unsigned int i = 0; i < numBuffers; ++i) {
+        buffers.emplace_back(new EncodeFrame());
+        buffers.back()->pixels.resize(frameBytes);
+        freeFrames.push(buffers.back().get());
+    }
+    for (unsigned int i = 0; i < numThreads; ++i) {
+        workers.emplace_back(&FrameEncoder::work, this);
+    }
+}
+
+FrameEncoder::~FrameEncoder()
+{
+    finish();
+}
+
+EncodeFrame* FrameEncoder::acquire()
+{
+    EncodeFrame* frame = nullptr;
+    if (freeFrames.tryPop(frame)) return frame;
+    auto start = std::chrono::steady_clock::now();
+    freeFrames.pop(frame);
+    waitTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return frame;
+}
+
+void FrameEncoder::submit(EncodeFrame* frame)
+{
+    queuedFrames.push(frame);
+}
+
+void FrameEncoder::finish()
+{
+    queuedFrames.close();
+    for (auto& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+void FrameEncoder::work()
+{
+    EncodeFrame* frame = nullptr;
+    while (queuedFrames.pop(frame)) {
+        auto start = std::chrono::steady_clock::now();
+        encode(*frame);
+        encodeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        ++encoded;
+        freeFrames.push(frame);
+    }
+}
@@ -0,0 +1,284 @@
+#include "frame_sink.h"
+
+#include <algorithm>
+#include <boost/format.hpp>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <unistd.h>
+
+#include "image_writers.h"
+
+namespace fs = std::filesystem;
+
+ImageDirectorySink::ImageDirectorySink(unsigned int width, unsigned int height, const std::string& directory, unsigned int threads,
+                                       ImageFormat format, int pngCompression, int pngStrips)
+    : FrameSink(width, height), directory(directory), threads(threads), format(format), pngCompression(pngCompression),
+      pngStrips(pngStrips)
+{
+}
+
+void ImageDirectorySink::write(const FrameView& frame)
+{
+    // the encoders flip the rows and swap the channels as they go, so the pixels are used in place;
+    // every encoder thread keeps its file buffer between frames
+    thread_local std::vector<unsigned char> encoded;
+    encoded.clear();
+    switch (format) {
+        case ImageFormat::PNG: encodePng(frame.pixels, width, height, pngCompression, pngStrips, encoded); break;
+        case ImageFormat::QOI: encodeQoi(frame.pixels, width, height, encoded); break;
+        case ImageFormat::PPM: encodePpm(frame.pixels, width, height, encoded); break;
+    }
+
+    // called from the encoder threads, so every message is written at once
+    std::string filename = this->filename(frame.index);
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file && fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size() && fclose(file) == 0) {
+        written += encoded.size();
+        ++files;
+        std::cout << "Saved framebuffer to " + filename + "\n" << std::flush;
+    } else {
+        if (file) fclose(file);
+        std::cerr << "Failed to save image!\n" << std::flush;
+    }
+}
+
+void ImageDirectorySink::repeat(const FrameView& frame, int index, float time)
+{
+    std::string source = filename(frame.index), target = filename(index);
+    std::error_code error;
+    fs::remove(target, error);
+    fs::create_hard_link(source, target, error);
+    if (error) {
+        // a file system without hard links
+        ImageDirectorySink::write({frame.pixels, index, time});
+        return;
+    }
+    ++files;
+    std::cout << "Linked " + target + " to " + source + "\n" << std::flush;
+}
+
+std::string ImageDirectorySink::filename(int index) const
+{
+    return str(boost::format("%s/frame_%04d.%s") % directory % index % imageFormatName(format));
+}
+
+std::string ImageDirectorySink::description() const
+{
+    std::string name = imageFormatName(format);
+    for (char& c : name) c = std::toupper(c);
+    return str(boost::format("%d %s files in %s") % files.load() % name % directory);
+}
+
+VideoSink::VideoSink(unsigned int width, unsigned int height, const std::string& path, const std::string& codec, double fps)
+    : FrameSink(width, height), path(path)
+{
+    writer.open(path, cv::VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]), fps, cv::Size(width, height));
+}
+
+void VideoSink::write(const FrameView& frame)
+{
+    cv::flip(cv::Mat(height, width, CV_8UC3, (void*)frame.pixels), image, 0);
+    writer.write(image);
+}
+
+void VideoSink::repeat(const FrameView&, int, float)
+{
+    writer.write(image);
+}
+
+void VideoSink::finish()
+{
+    writer.release();
+    // the writer does not report what it wrote; the size is (uintmax_t)-1 if the file cannot be read
+    std::error_code error;
+    uintmax_t size = fs::file_size(path, error);
+    if (error) {
+        std::cout << "ERROR::SINK:: Failed to get the size of " << path << ": " << error.message() << std::endl;
+        return;
+    }
+    written = size;
+}
+
+RawSink::RawSink(unsigned int width, unsigned int height, FILE* file, const std::string& name)
+    : FrameSink(width, height), file(file), name(name)
+{
+}
+
+RawSink::~RawSink()
+{
+    finish();
+}
+
+void RawSink::write(const FrameView& frame)
+{
+    if (failed) return;
+    // rows go out in reverse, so the image needs no flipped copy
+    const size_t rowBytes = 3 * (size_t)width;
+    for (unsigned int row = height; row-- > 0; ) {
+        const size_t rowWritten = fwrite(frame.pixels + row * rowBytes, 1, rowBytes, file);
+        written += rowWritten;
+        if (rowWritten < rowBytes) {
+            // e.g. a full disk; the stream is cut mid-frame, so nothing after it is usable
+            std::cout << "ERROR::SINK:: Failed to write frame " << frame.index << " to " << name << ": "
+                      << std::strerror(errno) << ", dropping the remaining frames" << std::endl;
+            failed = true;
+            return;
+        }
+    }
+}
+
+void RawSink::finish()
+{
+    if (!file) return;
+    // the last buffered rows only fail here
+    if (fclose(file) != 0 && !failed) {
+        std::cout << "ERROR::SINK:: Failed to write the last frames to " << name << ": " << std::strerror(errno) << std::endl;
+    }
+    file = nullptr;
+}
+
+Y4mSink::Y4mSink(unsigned int width, unsigned int height, FILE* file, const std::string& name, double fps)
+    : FrameSink(width, height), file(file), name(name)
+{
+    // frame rate as a fraction with millisecond precision
+    written += fprintf(file, "YUV4MPEG2 W%u H%u F%ld:1000 Ip A1:1 C420jpeg\n", width, height, std::lround(fps * 1000.0));
+}
+
+Y4mSink::~Y4mSink()
+{
+    finish();
+}
+
+void Y4mSink::write(const FrameView& frame)
+{
+    written += fprintf(file, "FRAME\n");
+    written += fwrite(frame.pixels, 1, frameBytes(), file);
+}
+
+void Y4mSink::finish()
+{
+    if (!file) return;
+    fclose(file);
+    file = nullptr;
+}
+
+ShmSink::ShmSink(unsigned int width, unsigned int height, ShmRing* ring, const std::string& name, unsigned int timeoutSeconds)
+    : FrameSink(width, height), ring(ring), name(name), timeoutSeconds(timeoutSeconds)
+{
+}
+
+unsigned char* ShmSink::nextSlot(int index)
+{
+    // waits while the consumer holds every slot, and says so every few seconds
+    const unsigned int LOG_INTERVAL = 5;
+    unsigned char* slot = nullptr;
+    for (unsigned int waited = 0; !abandoned && !(slot = ring->beginWrite(std::min(LOG_INTERVAL, timeoutSeconds - waited)));) {
+        waited = std::min(waited + LOG_INTERVAL, timeoutSeconds);
+        if (waited >= timeoutSeconds) {
+            std::cout << "ERROR::SINK:: No consumer read from shared memory " << name << " for " << timeoutSeconds
+                      << " s, dropping frame " << index << " and the ones after it" << std::endl;
+            abandoned = true;
+        } else {
+            std::cout << "Waiting " << waited << " s for a consumer of shared memory " << name << std::endl;
+        }
+    }
+    return slot;
+}
+
+unsigned char* ShmSink::frameMemory(int index)
+{
+    pendingSlot = nextSlot(index);
+    return pendingSlot;
+}
+
+void ShmSink::write(const FrameView& frame)
+{
+    // a frame read back into its slot is published as it is, any other one is copied into a slot
+    unsigned char* slot = pendingSlot && frame.pixels == pendingSlot ? pendingSlot : nextSlot(frame.index);
+    pendingSlot = nullptr;
+    if (!slot) return;
+    if (slot != frame.pixels) {
+        std::memcpy(slot, frame.pixels, frameBytes());
+    }
+    ring->endWrite(frame.index, frame.time);
+    written += frameBytes();
+}
+
+void ShmSink::finish()
+{
+    ring->close();
+}
+
+// Opens path for writing, "-" being stdout. The process' stdout is then duplicated for the
+// stream and replaced by stderr, so nothing logged with std::cout ends up between the frames.
+static FILE* openStream(const std::string& path)
+{
+    if (path != "-") {
+        return fopen(path.c_str(), "wb");
+    }
+    std::cout << std::flush;
+    fflush(stdout);
+    int stream = dup(STDOUT_FILENO);
+    if (stream < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+        return nullptr;
+    }
+    return fdopen(stream, "wb");
+}
+
+std::unique_ptr<FrameSink> createFrameSink(const Settings& settings, double fps, unsigned int encoderThreads)
+{
+    const unsigned int width = settings.outputWidth, height = settings.outputHeight;
+    std::string path = settings.sinkPath;
+    switch (settings.sink) {
+        case SinkType::PNG: {
+            if (path.empty()) path = "frames";
+            std::error_code error;
+            fs::create_directories(path, error);
+            return std::unique_ptr<FrameSink>(new ImageDirectorySink(width, height, path, encoderThreads, settings.imageFormat,
+                                                                     settings.pngCompression, settings.pngStrips));
+        }
+        case SinkType::VIDEO: {
+            if (path.empty()) path = "frames.mp4";
+            auto sink = std::unique_ptr<VideoSink>(new VideoSink(width, height, path, settings.videoCodec, fps));
+            if (!sink->isOpened()) {
+                std::cout << "ERROR::SINK:: Failed to open " << path << " with codec " << settings.videoCodec << std::endl;
+                return nullptr;
+            }
+            return std::move(sink);
+        }
+        case SinkType::RAW:
+        case SinkType::Y4M: {
+            if (path.empty()) path = "-";
+            if (settings.sink == SinkType::Y4M && (width % 2 != 0 || height % 2 != 0)) {
+                std::cout << "ERROR::SINK:: 4:2:0 output needs an even width and height" << std::endl;
+                return nullptr;
+            }
+            FILE* file = openStream(path);
+            if (!file) {
+                std::cout << "ERROR::SINK:: Failed to open " << path << std::endl;
+                return nullptr;
+            }
+            std::string name = path == "-" ? "stdout" : path;
+            if (settings.sink == SinkType::RAW) {
+                return std::unique_ptr<FrameSink>(new RawSink(width, height, file, name));
+            }
+            return std::unique_ptr<FrameSink>(new Y4mSink(width, height, file, name, fps));
+        }
+        case SinkType::SHM: {
+            if (path.empty()) path = "/convcubes";
+            // four frames of slack between the renderer and the consumer
+            ShmRing* ring = ShmRing::create(path, width, height, 3 * (uint64_t)width * height, 4);
+            if (!ring) {
+                std::cout << "ERROR::SINK:: Failed to create shared memory " << path << std::endl;
+                return nullptr;
+            }
+            std::cout << "Writing frames to shared memory " << path << std::endl;
+            return std::unique_ptr<FrameSink>(new ShmSink(width, height, ring, path, settings.shmTimeout));
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,226 @@
+#include "image_writers.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include <zlib.h>
+
+static void appendU32(std::vector<unsigned char>& out, uint32_t value)
+{
+    out.push_back(value >> 24);
+    out.push_back(value >> 16);
+    out.push_back(value >> 8);
+    out.push_back(value);
+}
+
+// source row of output row y, which counts from the top
+static const unsigned char* topDownRow(const unsigned char* pixels, int width, int height, int y)
+{
+    return pixels + (size_t)(height - 1 - y) * width * 3;
+}
+
+// PNG
+// ---
+
+static unsigned char paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+// Filter one RGB row with whichever of None, Sub, Up and Paeth gives the smallest sum of absolute
+// signed bytes, the usual heuristic for the filter that deflates best
+static void filterRow(const unsigned char* row, const unsigned char* prior, int rowBytes, bool adaptive,
+                      std::vector<unsigned char>& candidates, unsigned char* out)
+{
+    if (!adaptive) {
+        out[0] = 0;
+        std::memcpy(out + 1, row, rowBytes);
+        return;
+    }
+    candidates.resize(4 * (size_t)rowBytes);
+    long best = -1;
+    int bestFilter = 0;
+    for (int filter = 0; filter < 4; ++filter) {
+        unsigned char* candidate = candidates.data() + (size_t)filter * rowBytes;
+        long cost = 0;
+        for (int i = 0; i < rowBytes; ++i) {
+            int left = i >= 3 ? row[i - 3] : 0;
+            int up = prior ? prior[i] : 0;
+            int upLeft = prior && i >= 3 ? prior[i - 3] : 0;
+            unsigned char predicted = filter == 0 ? 0 : filter == 1 ? left : filter == 2 ? up : paeth(left, up, upLeft);
+            candidate[i] = row[i] - predicted;
+            cost += std::abs((int)(signed char)candidate[i]);
+        }
+        if (best < 0 || cost < best) {
+            best = cost;
+            bestFilter = filter;
+        }
+    }
+    // the filter types of PNG are None 0, Sub 1, Up 2, Average 3 and Paeth 4
+    out[0] = bestFilter == 3 ? 4 : bestFilter;
+    std::memcpy(out + 1, candidates.data() + (size_t)bestFilter * rowBytes, rowBytes);
+}
+
+static void appendChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size)
+{
+    appendU32(out, size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    appendU32(out, crc32(0, out.data() + start, size + 4));
+}
+
+void encodePng(const unsigned char* pixels, int width, int height, int level, int strips, std::vector<unsigned char>& out)
+{
+    const int rowBytes = 3 * width;
+    strips = std::max(1, std::min(strips, height));
+
+    // every strip filters and deflates its rows on its own; all but the last end on a byte-aligned
+    // sync flush instead of a final block, so the raw deflate streams simply concatenate
+    struct Strip {
+        std::vector<unsigned char> deflated;
+        uLong adler;
+        size_t filteredBytes;
+    };
+    std::vector<Strip> stripData(strips);
+    cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range& range) {
+        std::vector<unsigned char> filtered, candidates, rgb, priorRgb;
+        for (int s = range.start; s < range.end; ++s) {
+            int y0 = (int)((long)height * s / strips), y1 = (int)((long)height * (s + 1) / strips);
+            filtered.resize((size_t)(y1 - y0) * (rowBytes + 1));
+            rgb.resize(rowBytes);
+            priorRgb.resize(rowBytes);
+            for (int y = y0; y < y1; ++y) {
+                // the row above is the last one of the previous strip at a strip's start
+                if (y > 0) {
+                    const unsigned char* prior = topDownRow(pixels, width, height, y - 1);
+                    for (int i = 0; i < rowBytes; i += 3) {
+                        priorRgb[i] = prior[i + 2]; priorRgb[i + 1] = prior[i + 1]; priorRgb[i + 2] = prior[i];
+                    }
+                }
+                const unsigned char* row = topDownRow(pixels, width, height, y);
+                for (int i = 0; i < rowBytes; i += 3) {
+                    rgb[i] = row[i + 2]; rgb[i + 1] = row[i + 1]; rgb[i + 2] = row[i];
+                }
+                filterRow(rgb.data(), y > 0 ? priorRgb.data() : nullptr, rowBytes, level > 0, candidates,
+                          filtered.data() + (size_t)(y - y0) * (rowBytes + 1));
+            }
+
+            Strip& strip = stripData[s];
+            strip.filteredBytes = filtered.size();
+            strip.adler = adler32(adler32(0, nullptr, 0), filtered.data(), filtered.size());
+            z_stream stream = {};
+            deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+            strip.deflated.resize(deflateBound(&stream, filtered.size()) + 16);
+            stream.next_in = filtered.data();
+            stream.avail_in = filtered.size();
+            stream.next_out = strip.deflated.data();
+            stream.avail_out = strip.deflated.size();
+            deflate(&stream, s == strips - 1 ? Z_FINISH : Z_SYNC_FLUSH);
+            strip.deflated.resize(stream.total_out);
+            deflateEnd(&stream);
+        }
+    });
+
+    // zlib header, the strips, and the Adler-32 of all filtered rows
+    std::vector<unsigned char> idat = {0x78, 0x9C};
+    uLong adler = adler32(0, nullptr, 0);
+    for (const auto& strip : stripData) {
+        idat.insert(idat.end(), strip.deflated.begin(), strip.deflated.end());
+        adler = adler32_combine(adler, strip.adler, strip.filteredBytes);
+    }
+    appendU32(idat, adler);
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.insert(out.end(), signature, signature + 8);
+    std::vector<unsigned char> header;
+    appendU32(header, width);
+    appendU32(header, height);
+    header.insert(header.end(), {8, 2, 0, 0, 0});  // 8 bits per channel, RGB, deflate, no interlacing
+    appendChunk(out, "IHDR", header.data(), header.size());
+    appendChunk(out, "IDAT", idat.data(), idat.size());
+    appendChunk(out, "IEND", nullptr, 0);
+}
+
+// QOI
+// ---
+
+void encodeQoi(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& out)
+{
+    const unsigned char OP_INDEX = 0x00, OP_DIFF = 0x40, OP_LUMA = 0x80, OP_RUN = 0xC0, OP_RGB = 0xFE;
+    out.insert(out.end(), {'q', 'o', 'i', 'f'});
+    appendU32(out, width);
+    appendU32(out, height);
+    out.push_back(3);  // channels
+    out.push_back(0);  // sRGB with linear alpha
+
+    // alpha is always 255, so it stays out of the comparisons but counts in the index hash
+    unsigned char index[64][3] = {};
+    bool indexSet[64] = {};
+    unsigned char prev[3] = {0, 0, 0};
+    int run = 0;
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = topDownRow(pixels, width, height, y);
+        for (int x = 0; x < width; ++x) {
+            const unsigned char px[3] = {row[3 * x + 2], row[3 * x + 1], row[3 * x]};
+            if (px[0] == prev[0] && px[1] == prev[1] && px[2] == prev[2]) {
+                if (++run == 62) {
+                    out.push_back(OP_RUN | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                out.push_back(OP_RUN | (run - 1));
+                run = 0;
+            }
+            int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + 255 * 11) % 64;
+            if (indexSet[hash] && std::memcmp(index[hash], px, 3) == 0) {
+                out.push_back(OP_INDEX | hash);
+            } else {
+                std::memcpy(index[hash], px, 3);
+                indexSet[hash] = true;
+                signed char dr = px[0] - prev[0], dg = px[1] - prev[1], db = px[2] - prev[2];
+                signed char drg = dr - dg, dbg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    out.push_back(OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                    out.push_back(OP_LUMA | (dg + 32));
+                    out.push_back((drg + 8) << 4 | (dbg + 8));
+                } else {
+                    out.insert(out.end(), {OP_RGB, px[0], px[1], px[2]});
+                }
+            }
+            std::memcpy(prev, px, 3);
+        }
+    }
+    if (run > 0) {
+        out.push_back(OP_RUN | (run - 1));
+    }
+    out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+}
+
+// PPM
+// ---
+
+void encodePpm(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& out)
+{
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    out.insert(out.end(), header.begin(), header.end());
+    size_t start = out.size();
+    out.resize(start + (size_t)3 * width * height);
+    unsigned char* dst = out.data() + start;
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = topDownRow(pixels, width, height, y);
+        for (int i = 0; i < 3 * width; i += 3, dst += 3) {
+            dst[0] = row[i + 2];
+            dst[1] = row[i + 1];
+            dst[2] = row[i];
+        }
+    }
+}
@@ -9,6 +9,12 @@
 #include "shader.h"
 #include "cube.h"
 #include "camera.h"
+#include "frustum.h"
+#include "settings.h"
+#include "frame_encoder.h"
+#include "frame_sink.h"
+#include "image_writers.h"
+#include "timeline.h"
 
 #include <filesystem>
 #include <iostream>
@@ -20,7 +26,6 @@ using namespace std;
 namespace fs = std::filesystem;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void saveFrameBuffer(const std::string& filename);
 double randDouble();
 
 enum class EasingType : int {
@@ -45,12 +50,134 @@ struct InstanceDataTrans {
     int endIdxs[TRANS_KEYFRAMES];
 };
 
+// Per-plane data for the shaders that draw a whole channel plane at once
+struct PlaneData {
+    float origin[3];  // Position of the cube in row 0, column 0
+    int cols;
+    int rows;
+    int firstInstance;
+};
+
 struct ChanInfo {
     ChanInfo(int l, int c) : layer(l), channel(c) {};
     const int layer;
     const int channel;
 };
 
+// Levels of the channel plane pyramids: the image cubes, then cubes of 2x2, 4x4 and 8x8 of them
+const int PLANE_MIP_LEVELS = 4;
+
+// One level of a channel plane pyramid; the cubes of level l have edge length 2^l and the
+// average color of the image cubes they cover. Only whole blocks are merged: the image cubes
+// right of and below them, where the plane's size is not a multiple of 2^l, are kept as they are.
+struct PlaneMip {
+    int firstInstance;
+    int numInstances;
+    int rows;  // whole blocks
+    int cols;
+    int edgeFirstInstance = 0;  // copies of the image cubes outside the whole blocks
+    int edgeNumInstances = 0;
+};
+
+// A (layer, channel) plane of cubes. Its instances are contiguous in the instance buffers.
+struct ChannelPlane {
+    int layer;
+    int channel;
+    int firstInstance;
+    int numInstances;
+    int rows;
+    int cols;
+    glm::vec3 bboxMin;  // Bounds of the still cubes, including their extent
+    glm::vec3 bboxMax;
+    float time;  // All still cubes of the plane arrive at this time; nothing about them changes after this
+    float transStartTime;  // Time interval in which cubes of this plane move to the next layer
+    float transEndTime;
+    glm::vec3 transBboxMin;  // Bounds of the transition cubes: this plane and the whole next layer
+    glm::vec3 transBboxMax;
+    PlaneMip mips[PLANE_MIP_LEVELS];  // Level 0 is the plane itself; coarser levels are still-only instances after all planes
+};
+
+// One plane's instances drawn with a given cube LOD
+struct CubeDraw {
+    int lod;
+    int firstInstance;
+    int numInstances;
+    bool hullOutline = false;  // the outline pass draws the plane's merged hull instead of these cubes
+    float cubeSize = 1.0f;  // edge length of the cubes, larger for coarse plane levels
+    int plane = -1;  // plane the instances belong to
+};
+
+// Consecutive occlusion-culled indirect commands of runs with the same cube size and outline
+struct CulledRuns {
+    int firstCommand;
+    int numCommands;
+    float cubeSize;
+    bool hullOutline;
+};
+
+// Everything one pass over the planes draws: cube meshes, impostors and settled-plane slabs
+struct PassDraws {
+    vector<CubeDraw> mesh;
+    vector<CubeDraw> impostor;
+    vector<CubeDraw> slabs;  // instances of a slab draw are planes
+    vector<int> hulls;  // planes whose outline pass is their merged hull
+    vector<CubeDraw> splats;  // instances whose smallest cubes go through the software rasterizer
+    bool culled = false;  // mesh and impostor runs are drawn from the occlusion-culled indirect commands
+    vector<CulledRuns> culledRuns;  // with culled, where the commands of the runs are
+};
+
+// Layouts of the commands read by glMultiDrawElementsIndirect and glMultiDrawArraysIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+const int MAX_LAYERS = 64;  // Size of the per-layer culling statistics
+
+// Pixel pack buffer a frame is read back through, and the fence of the commands that fill it
+struct ReadbackSlot {
+    GLuint buffer = 0;
+    GLsync fence = 0;
+    int frame = -1;  // frame in the buffer, -1 while it is free
+    float time = 0.0f;
+    int repeats = 0;  // frames after it that look the same and are written from its pixels
+};
+
+// GPU timers and culling statistics of one frame, reported two frames later like the read back pixels
+// so the CPU never waits for them
+struct GpuStatsSlot {
+    vector<GLuint> cubePassQueries;    // per tile and accumulation pass
+    vector<GLuint> downsampleQueries;  // per tile
+    vector<GLuint> softRasterQueries;  // start and end timestamp per tile
+    vector<char> softRasterUsed;       // per tile
+    vector<char> culled;               // per tile, its culling statistics were copied
+    GLuint cullStatsBuffer = 0;        // 4 * MAX_LAYERS counters per tile
+    GLsync fence = 0;
+    int frame = -1;  // frame measured, -1 while it is free
+};
+
+// Part of the output rendered in one pass, in output pixels from the bottom-left corner of the frame
+struct OutputTile {
+    unsigned int x;
+    unsigned int y;
+    unsigned int width;
+    unsigned int height;
+};
+
+glm::vec2 projectedCubeSizeRange(const ChannelPlane& plane, const glm::mat4& view, const glm::mat4& projection, float viewportHeight);
+bool readJpegSize(const fs::path& path, cv::Size& size);
+float halton(int index, int base);
+
 ChanInfo pathToInfo(const fs::path &path) {
     std::regex del("_");
     std::string stem = path.stem();
@@ -63,22 +190,76 @@ ChanInfo pathToInfo(const fs::path &path) {
 }
 
 // settings
+// size of the window, which only shows a preview of the output
 const unsigned int SCR_WIDTH = 1920;
 const unsigned int SCR_HEIGHT = 1080;
 
-const unsigned int FB_HEIGHT = 3840*4;
-const unsigned int FB_WIDTH = 2160*4;
+// output size and supersampling, set from the command line
+Settings settings;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 50.0f));
 
-unsigned int cubeVAO = 0, vertexVBO = 0;
+unsigned int cubeVAO = 0, vertexVBO = 0, indexEBO = 0;
 unsigned int framebuffer = 0;
 unsigned int textureColorbuffer = 0;
-unsigned int rbo = 0;
+unsigned int depthbuffer = 0;
+unsigned int hiZTexture = 0;
+unsigned int cacheFramebuffer = 0;
+unsigned int msaaFramebuffer = 0;
+unsigned int msaaColorbuffer = 0;
+unsigned int msaaDepthbuffer = 0;
+unsigned int accumulationTexture = 0;
+unsigned int cacheColorbuffer = 0;
+unsigned int cacheDepthbuffer = 0;
+unsigned int visFramebuffer = 0;
+unsigned int visibilitybuffer = 0;
+unsigned int cacheVisFramebuffer = 0;
+unsigned int cacheVisibilitybuffer = 0;
+unsigned int outputFramebuffer = 0;
+unsigned int outputTexture = 0;
+
+
+int main(int argc, char** argv)
+{
+    if (!parseSettings(argc, argv, settings)) {
+        return -1;
+    }
 
+    // frames go to the sink selected in the settings; one on stdout moves all logging to stderr
+    // first, so it is set up before anything is printed
+    bool saveFrame = true;
+    float fps = 60.;
+    size_t frameBytes = 0;
+    const unsigned int encoderThreads = settings.encoderThreads > 0 ? settings.encoderThreads
+                                                                    : std::max(2u, std::thread::hardware_concurrency()) - 1;
+    std::unique_ptr<FrameSink> sink;
+    std::unique_ptr<FrameEncoder> encoder;
+    if (saveFrame) {
+        sink = createFrameSink(settings, fps, encoderThreads);
+        if (!sink) {
+            return -1;
+        }
+        frameBytes = sink->frameBytes();
+        // sinks that encode get a pool of threads, with two buffers per thread so every encoder
+        // stays busy while the render thread fills the next ones, as far as the memory budget allows;
+        // threads without a buffer of their own would only wait
+        if (sink->maxThreads() > 0) {
+            const size_t budgetBuffers = std::max<size_t>(1, ((size_t)settings.encoderMemory << 20) / frameBytes);
+            const unsigned int numBuffers = std::min<size_t>(2 * sink->maxThreads(), budgetBuffers);
+            const unsigned int numThreads = std::min(sink->maxThreads(), numBuffers);
+            if (numBuffers < 2 * sink->maxThreads()) {
+                std::cout << "Encoder buffers limited to " << numBuffers << " of " << frameBytes / (1024.0 * 1024.0)
+                          << " MiB by --encoder-memory=" << settings.encoderMemory << std::endl;
+            }
+            encoder.reset(new FrameEncoder(frameBytes, numThreads, numBuffers, [&](const EncodeFrame& frame) {
+                sink->write({frame.pixels.data(), frame.index, frame.time});
+                for (int i = 1; i <= frame.repeats; ++i) {
+                    sink->repeat({frame.pixels.data(), frame.index, frame.time}, frame.index + i, frame.time + i / fps);
+                }
+            }));
+        }
+    }
 
-int main()
-{
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -109,6 +290,8 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // timings only compare within one driver, e.g. a GPU against Mesa's llvmpipe
+    std::cout << "OpenGL renderer: " << glGetString(GL_RENDERER) << ", " << glGetString(GL_VERSION) << std::endl;
 
     // configure global opengl state
     // -----------------------------
@@ -122,9 +305,117 @@ int main()
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    // output tiles
+    // ------------
+    // the output is rendered in tiles of equal size, each with its own off-center part of the frame's
+    // frustum, so the framebuffers never exceed the texture size limit and memory only grows with the tile
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    // Cubes projecting to fewer framebuffer pixels than this are ray-cast on a screen-aligned quad instead of drawn as a mesh
+    const float IMPOSTOR_THRESHOLD = 16.0;
+    // Tiles render a border around the pixels they output, which is cropped: wide enough for Lanczos,
+    // which reads three output pixels around every output pixel, and for the largest impostor quad (its
+    // bounding sphere plus two pixels of margin), so everything that reaches into a tile is drawn whole
+    const unsigned int LANCZOS_GUARD = settings.downsampleFilter == DownsampleFilter::LANCZOS ? 3 : 0;
+    const unsigned int IMPOSTOR_GUARD = (unsigned int)std::ceil((IMPOSTOR_THRESHOLD * std::sqrt(3.0f) / 2.0f + 2.0f) / settings.supersampling);
+    // sinks of 4:2:0 frames get them converted on the GPU (the sink checks that the frame size is even)
+    const bool YUV_READBACK = sink && sink->pixelOrder() == PixelOrder::YUV420;
+    // the shm sink gets its frames read back straight into a slot of its ring instead of through the pack
+    // buffers, which saves copying every frame from a mapped buffer into the slot; that read waits for the GPU
+    const bool DIRECT_READBACK = sink && settings.sink == SinkType::SHM;
+    unsigned int tileWidth = settings.outputWidth, tileHeight = settings.outputHeight, tileGuard = 0;
+    bool fitsTexture = std::max(settings.outputWidth, settings.outputHeight) * settings.supersampling <= (unsigned int)maxTextureSize;
+    // tiles are used when asked for, and whenever the whole frame does not fit, whatever the tile size
+    if ((settings.tileSize > 0 && settings.tileSize < std::max(settings.outputWidth, settings.outputHeight)) || !fitsTexture) {
+        tileGuard = std::max(LANCZOS_GUARD, IMPOSTOR_GUARD);
+        unsigned int maxTileSize = maxTextureSize / settings.supersampling - 2 * tileGuard;
+        tileWidth = tileHeight = settings.tileSize > 0 ? std::min(settings.tileSize, maxTileSize) : maxTileSize;
+        if (YUV_READBACK) {
+            // every tile covers whole 2x2 chroma blocks
+            tileWidth = tileHeight = std::max(2u, tileWidth & ~1u);
+        }
+    }
+    vector<OutputTile> tiles;
+    for (unsigned int y = 0; y < settings.outputHeight; y += tileHeight) {
+        for (unsigned int x = 0; x < settings.outputWidth; x += tileWidth) {
+            // tiles at the right and top edge reach past the frame, their outside pixels are dropped
+            tiles.push_back({x, y, std::min(tileWidth, settings.outputWidth - x), std::min(tileHeight, settings.outputHeight - y)});
+        }
+    }
+    // the downsampled tile including its border, and the framebuffer with settings.supersampling pixels per output pixel
+    const unsigned int TILE_OUTPUT_WIDTH = tileWidth + 2 * tileGuard;
+    const unsigned int TILE_OUTPUT_HEIGHT = tileHeight + 2 * tileGuard;
+    const unsigned int FB_WIDTH = TILE_OUTPUT_WIDTH * settings.supersampling;
+    const unsigned int FB_HEIGHT = TILE_OUTPUT_HEIGHT * settings.supersampling;
+    std::cout << "Output " << settings.outputWidth << "x" << settings.outputHeight << ", framebuffer " << FB_WIDTH << "x"
+              << FB_HEIGHT << ", " << downsampleFilterName(settings.downsampleFilter) << " downsample";
+    if (tiles.size() > 1) {
+        std::cout << ", " << tiles.size() << " tiles of " << tileWidth << "x" << tileHeight << " + " << tileGuard << " border";
+    }
+    std::cout << std::endl;
+
+    // rendering options
+    // -----------------
+    // Morph of the cubes towards spheres, 0 draws plain cubes
+    const float SPHERENESS = 0.0;
+    // Vertex layout of the cube meshes
+    const CubeVertexFormat CUBE_VERTEX_FORMAT = CubeVertexFormat::PACKED;
+    // Draw channel planes whose cubes have all arrived as one ray-cast slab instead of per-cube
+    const bool SETTLED_PLANE_SLABS = settings.settledPlanes == SettledPlanes::SLABS;
+    // Without slabs, draw the outlines of settled planes as one merged hull per plane; only
+    // exact while the outline cubes are flat-faced
+    const bool MERGED_OUTLINE_HULLS = !SETTLED_PLANE_SLABS && settings.outlineHulls && SPHERENESS == 0.0f;
+    // Render the cube passes multisampled and resolve them with a blit instead of supersampling
+    const bool MSAA = settings.antiAliasing == AntiAliasing::MSAA;
+    GLint maxSamples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    const int MSAA_SAMPLES = std::min((int)settings.msaaSamples, maxSamples);
+    // Average this many sub-pixel jittered passes per frame, optionally spread over the shutter interval
+    const bool ACCUMULATION = settings.antiAliasing == AntiAliasing::ACCUMULATION;
+    const unsigned int ACCUMULATION_PASSES = ACCUMULATION ? settings.accumulationPasses : 1;
+    const float SHUTTER = ACCUMULATION ? settings.shutter : 0.0f;
+    // Keep settled planes in a persistent color+depth layer and only draw the planes that settled since the last frame;
+    // the layer holds a single view, so not when rendering in tiles or jittered passes
+    const bool INCREMENTAL_RENDERING = tiles.size() == 1 && ACCUMULATION_PASSES == 1;
+    // Drop transition cubes hidden behind the settled planes before drawing them; the depth pyramid
+    // is built from a single-sampled depth texture, so not with MSAA
+    const bool OCCLUSION_CULLING = !MSAA;
+    // With occlusion culling, the still cubes of this many planes nearest to the camera are drawn
+    // first, and the still cubes of the other planes are culled against the depth they leave
+    const int OCCLUDER_PLANES = 4;
+    // Cubes projecting to fewer framebuffer pixels than this are splatted by a compute shader instead
+    // of drawn as impostors; not used for the cache layer, 0 disables the software rasterizer
+    const float SOFT_RASTER_THRESHOLD = settings.softRasterThreshold;
+    // Draw settled planes from the coarsest level of their pyramid whose merged cubes cover at most
+    // this many output pixels; 0 always draws the image cubes
+    const float PLANE_MIP_THRESHOLD = settings.planeMipThreshold;
+    // Draw instance and face IDs into an integer visibility buffer and shade every pixel once
+    // in a full-screen resolve pass; only exact while the cubes are flat-faced, and not with MSAA
+    // as the resolve shades one sample per pixel
+    const bool VISIBILITY_BUFFER = settings.visibilityBuffer && SPHERENESS == 0.0f && !MSAA;
+    std::cout << "Visibility buffer: " << (VISIBILITY_BUFFER ? "on" : "off") << std::endl;
+    std::cout << "Settled planes: " << settledPlanesName(settings.settledPlanes);
+    if (!SETTLED_PLANE_SLABS) {
+        std::cout << ", outline hulls " << (MERGED_OUTLINE_HULLS ? "on" : "off") << ", pyramid threshold " << PLANE_MIP_THRESHOLD << " px";
+    }
+    std::cout << std::endl;
+
     // build and compile shaders
     // -------------------------
-    Shader shader("../shaders/vertex.shader", "../shaders/fragment.shader");
+    // the cube passes write visibility texels instead of colors in visibility buffer mode
+    const std::string cubeDefines = VISIBILITY_BUFFER ? "#define VISIBILITY_BUFFER" : "";
+    Shader shader("../shaders/vertex.shader", "../shaders/fragment.shader", cubeDefines);
+    Shader impostorShader("../shaders/impostor_vertex.shader", "../shaders/impostor_fragment.shader", cubeDefines);
+    Shader slabShader("../shaders/slab_vertex.shader", "../shaders/slab_fragment.shader", cubeDefines);
+    Shader hullShader("../shaders/hull_vertex.shader", "../shaders/fragment.shader", cubeDefines);
+    Shader resolveShader("../shaders/quad_tex_vertex.shader", "../shaders/visibility_resolve_fragment.shader");
+    Shader hiZShader("../shaders/hiz_build.compute");
+    Shader cullShader("../shaders/occlusion_cull.compute");
+    Shader softRasterShader("../shaders/soft_raster.compute");
+    Shader softRasterMergeShader("../shaders/quad_tex_vertex.shader", "../shaders/soft_raster_merge_fragment.shader");
+    Shader downsampleShader("../shaders/downsample.compute");
+    Shader accumulateShader("../shaders/accumulate.compute");
+    Shader yuvShader("../shaders/yuv420.compute");
     Shader screenShader("../shaders/quad_tex_vertex.shader", "../shaders/quad_tex_fragment.shader");
 
     // ---------------------------------------------------------
@@ -133,27 +424,71 @@ int main()
         sorted_files.insert(entry.path());
     }
 
+    // Maximum number of cubes of the input image (all its channels). Layer 0 is saved at full
+    // resolution and would otherwise outnumber all network layers together. Network layers keep
+    // their size, so each maps 2:1 onto the next, unless one exceeds the much larger limit below,
+    // which only guards against running out of memory.
+    const long INPUT_CUBE_BUDGET = 1 << 18;
+    const long NETWORK_LAYER_CUBE_LIMIT = 1 << 22;
+
     int numCubes = 0;
     vector<fs::path> sel_files{};
     map<int, vector<fs::path>> layerChanFiles;
     map<int, map<int, int>> pxCumCount;
+    map<fs::path, cv::Mat> chanImages;  // decoded once, used again when filling the instance data
+    map<int, cv::Size> layerSizes;
     int pathCounter = 0;
     for (const auto& path : sorted_files) {
-        cv::Mat img;
-        cv::imread(path.string(), img);
         const auto& cInfo = pathToInfo(path);
-        pxCumCount[cInfo.layer][cInfo.channel] = numCubes;
-        numCubes += img.rows * img.cols;
         sel_files.push_back(path);
-
         layerChanFiles[cInfo.layer].push_back(path);
 
         ++pathCounter;
         // if (pathCounter == 10) break;
     }
+    for (const auto& layerFiles : layerChanFiles) {
+        // layers over the budget are decoded at 1/2, 1/4 or 1/8 size straight from the JPEG
+        // DCT coefficients, which is much cheaper than decoding at full size and resizing
+        const int nChans = layerFiles.second.size();
+        const long cubeBudget = layerFiles.first == 0 ? INPUT_CUBE_BUDGET : NETWORK_LAYER_CUBE_LIMIT;
+        cv::Size fullSize;
+        int reduction = 1;
+        if (readJpegSize(layerFiles.second.front(), fullSize)) {
+            while (reduction < 8 && (long)nChans * fullSize.width * fullSize.height / (reduction * reduction) > cubeBudget) {
+                reduction *= 2;
+            }
+        }
+        const int readFlags = reduction == 8 ? cv::IMREAD_REDUCED_COLOR_8
+                            : reduction == 4 ? cv::IMREAD_REDUCED_COLOR_4
+                            : reduction == 2 ? cv::IMREAD_REDUCED_COLOR_2
+                            : cv::IMREAD_COLOR;
+        for (const auto& path : layerFiles.second) {
+            cv::Mat img;
+            cv::imread(path.string(), img, readFlags);
+            // the remaining factor beyond 1/8 is resized
+            double cubes = (double)nChans * img.rows * img.cols;
+            if (cubes > cubeBudget) {
+                double scale = std::sqrt(cubeBudget / cubes);
+                cv::resize(img, img, cv::Size(std::max(1, (int)(img.cols * scale)), std::max(1, (int)(img.rows * scale))), 0, 0, cv::INTER_AREA);
+            }
+            const auto& cInfo = pathToInfo(path);
+            pxCumCount[cInfo.layer][cInfo.channel] = numCubes;
+            numCubes += img.rows * img.cols;
+            layerSizes[cInfo.layer] = img.size();
+            chanImages[path] = img;
+        }
+        if (reduction > 1 || layerSizes[layerFiles.first].width < fullSize.width) {
+            // a reduced network layer no longer looks like the layer, and breaks its 2:1 mapping
+            std::cout << (layerFiles.first == 0 ? "" : "WARNING::LAYERS:: Network ") << "Layer " << layerFiles.first << ": "
+                      << fullSize.width << "x" << fullSize.height << " decoded at "
+                      << layerSizes[layerFiles.first].width << "x" << layerSizes[layerFiles.first].height
+                      << " (1/" << reduction << " JPEG scale) to stay within " << cubeBudget << " cubes" << std::endl;
+        }
+    }
 
     vector<InstanceDataStill> instanceDataStill(numCubes);
     vector<InstanceDataTrans> instanceDataTrans(numCubes);
+    vector<ChannelPlane> planes;
 
     float z = 0;
     int fileIdx = 0;
@@ -164,8 +499,8 @@ int main()
 
     for (const auto& path : sel_files) {
         const auto& cInfo = pathToInfo(path);
-        cv::Mat img1;
-        cv::imread(path.string(), img1);
+        cv::Mat img1 = chanImages[path];
+        chanImages.erase(path);
         cv::cvtColor(img1, img1, cv::COLOR_BGR2RGB);
         img1.convertTo(img1, CV_32FC1);
         img1 /= 255;
@@ -187,7 +522,25 @@ int main()
 
         // Still image + transition image
         int flatIdxStill = pxCumCount[cInfo.layer][cInfo.channel];
-        int nColsNextLayer = img1.cols / 2;
+        ChannelPlane plane;
+        plane.layer = cInfo.layer;
+        plane.channel = cInfo.channel;
+        plane.firstInstance = flatIdxStill;
+        plane.numInstances = img1.rows * img1.cols;
+        plane.rows = img1.rows;
+        plane.cols = img1.cols;
+        plane.bboxMin = glm::vec3(offsetX - 0.5f, -(img1.rows - 1 + offsetY) - 0.5f, z - 0.5f);
+        plane.bboxMax = glm::vec3(img1.cols - 1 + offsetX + 0.5f, -offsetY + 0.5f, z + 0.5f);
+        plane.time = currChanEndTime;
+        plane.transStartTime = std::numeric_limits<float>::max();
+        plane.transEndTime = std::numeric_limits<float>::lowest();
+        plane.mips[0] = {plane.firstInstance, plane.numInstances, plane.rows, plane.cols};
+
+        // cube (y, x) moves to the cube at the same relative position in the next layer, which
+        // is cube (y/2, x/2) when the next layer has half the resolution
+        auto nextLayerSize = layerSizes.find(cInfo.layer + 1);
+        int nColsNextLayer = nextLayerSize != layerSizes.end() ? nextLayerSize->second.width : img1.cols / 2;
+        int nRowsNextLayer = nextLayerSize != layerSizes.end() ? nextLayerSize->second.height : img1.rows / 2;
         int nChansNextLayer = pxCumCount[cInfo.layer + 1].size();
         for (int y = 0; y < img1.rows; ++y)
         {
@@ -212,21 +565,104 @@ int main()
                     float chanStartTime = nextLayerStartTime + chanIdx * chanDuration;
                     float chanEndTime = chanStartTime + chanDuration;
                     int chanFlatIdx0 = item.second;
-                    int y2 = y/2;
-                    int x2 = x/2;
+                    int y2 = (long)y * nRowsNextLayer / img1.rows;
+                    int x2 = (long)x * nColsNextLayer / img1.cols;
                     int endFlatIdx = chanFlatIdx0 + (y2*nColsNextLayer) + x2;
                     transData->endIdxs[chanIdx] = endFlatIdx;
                     float a = glm::sin((float)y2/nColsNextLayer * glm::pi<float>()/2);
                     transData->startTimes[chanIdx] = glm::mix(chanStartTime, chanEndTime, a/2);
                     transData->keyframeCount++;
+                    plane.transStartTime = std::min(plane.transStartTime, transData->startTimes[chanIdx]);
+                    plane.transEndTime = std::max(plane.transEndTime, chanEndTime);
                     ++chanIdx;
                 }
                 ++flatIdxStill;
             }
         }
+        planes.push_back(plane);
     }
 
-    Cube cube(5, 1.0);
+    // transition cubes move anywhere between their plane and the planes of the next layer
+    map<int, pair<glm::vec3, glm::vec3>> layerBboxes;
+    for (const auto& plane : planes) {
+        auto it = layerBboxes.find(plane.layer);
+        if (it == layerBboxes.end()) {
+            layerBboxes[plane.layer] = {plane.bboxMin, plane.bboxMax};
+        } else {
+            it->second.first = glm::min(it->second.first, plane.bboxMin);
+            it->second.second = glm::max(it->second.second, plane.bboxMax);
+        }
+    }
+    for (auto& plane : planes) {
+        plane.transBboxMin = plane.bboxMin;
+        plane.transBboxMax = plane.bboxMax;
+        auto next = layerBboxes.find(plane.layer + 1);
+        if (next != layerBboxes.end()) {
+            plane.transBboxMin = glm::min(plane.transBboxMin, next->second.first);
+            plane.transBboxMax = glm::max(plane.transBboxMax, next->second.second);
+        }
+    }
+
+    // coarser levels of every plane pyramid, appended to the still instances; transitions keep
+    // landing on the image cubes of level 0, the coarse cubes only replace settled planes
+    for (auto& plane : planes) {
+        const auto& firstCube = instanceDataStill[plane.firstInstance];
+        glm::vec3 origin(firstCube.position[0], firstCube.position[1], firstCube.position[2]);
+        for (int level = 1; level < PLANE_MIP_LEVELS; ++level) {
+            int block = 1 << level;
+            PlaneMip& mip = plane.mips[level];
+            mip.rows = plane.rows / block;
+            mip.cols = plane.cols / block;
+            mip.numInstances = mip.rows * mip.cols;
+            mip.firstInstance = instanceDataStill.size();
+            for (int by = 0; by < mip.rows; ++by) {
+                for (int bx = 0; bx < mip.cols; ++bx) {
+                    InstanceDataStill cube = {};
+                    for (int y = by * block; y < (by + 1) * block; ++y) {
+                        for (int x = bx * block; x < (bx + 1) * block; ++x) {
+                            const auto& fine = instanceDataStill[plane.firstInstance + y * plane.cols + x];
+                            for (int c = 0; c < 3; ++c) cube.color[c] += fine.color[c];
+                        }
+                    }
+                    for (int c = 0; c < 3; ++c) cube.color[c] /= block * block;
+                    cube.color[3] = 1.0;
+                    cube.position[0] = origin.x + bx * block + 0.5f * (block - 1);
+                    cube.position[1] = origin.y - (by * block + 0.5f * (block - 1));
+                    cube.position[2] = origin.z;
+                    cube.time = plane.time;
+                    instanceDataStill.push_back(cube);
+                }
+            }
+            // a cube of a partial block would stick out of the plane and sit off the cells it averages
+            mip.edgeFirstInstance = instanceDataStill.size();
+            for (int y = 0; y < plane.rows; ++y) {
+                for (int x = 0; x < plane.cols; ++x) {
+                    if (y < mip.rows * block && x < mip.cols * block) continue;
+                    instanceDataStill.push_back(instanceDataStill[plane.firstInstance + y * plane.cols + x]);
+                }
+            }
+            mip.edgeNumInstances = instanceDataStill.size() - mip.edgeFirstInstance;
+        }
+    }
+
+    // times at which the image changes, from the tables the shaders animate the cubes with: still cubes
+    // appear at their time, transition cubes are drawn from their start time to the time of the cube they
+    // move to
+    Timeline timeline;
+    for (const auto& cube : instanceDataStill) {
+        timeline.addStill(cube.time);
+    }
+    for (const auto& trans : instanceDataTrans) {
+        for (int i = 0; i < trans.keyframeCount; ++i) {
+            timeline.addTransition(trans.startTimes[i], instanceDataStill[trans.endIdxs[i]].time);
+        }
+    }
+
+    // Precomputed cube meshes for every LOD level; the 12-triangle cube is used unless the sphere morph is active
+    vector<Cube> cubeLods;
+    for (int subdivisions : CUBE_LOD_SUBDIVISIONS) {
+        cubeLods.emplace_back(subdivisions, 1.0);
+    }
 
     // store instance data in an array buffer
     // --------------------------------------
@@ -243,26 +679,96 @@ int main()
     glBufferData(GL_SHADER_STORAGE_BUFFER, instanceDataTrans.size() * sizeof(InstanceDataTrans), (const void*)instanceDataTrans.data(), GL_STATIC_DRAW);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, ssboTrans);
 
+    vector<PlaneData> planeData;
+    for (const auto& plane : planes) {
+        const auto& firstCube = instanceDataStill[plane.firstInstance];
+        planeData.push_back({{firstCube.position[0], firstCube.position[1], firstCube.position[2]},
+                             plane.cols, plane.rows, plane.firstInstance});
+    }
+    GLuint ssboPlanes;
+    glGenBuffers(1, &ssboPlanes);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssboPlanes);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, planeData.size() * sizeof(PlaneData), (const void*)planeData.data(), GL_STATIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, ssboPlanes);
+
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
-    std::vector<float> dataVec = cube.getInterleavedData();
-    float vertexData[dataVec.size()];
-    std::copy(dataVec.begin(), dataVec.end(), vertexData);
+    // all LOD meshes share one vertex and one index buffer; the indices of each level are
+    // relative to its lodBaseVertex and start at lodFirstIndex
+    const bool packedVertices = CUBE_VERTEX_FORMAT == CubeVertexFormat::PACKED;
+    const size_t vertexStride = packedVertices ? sizeof(PackedCubeVertex) : 6 * sizeof(float);
+    std::vector<unsigned char> vertexData;
+    std::vector<uint32_t> indexData;
+    vector<int> lodBaseVertex, lodFirstIndex, lodNumIndices;
+    for (const auto& lodCube : cubeLods) {
+        const auto* lodVertices = packedVertices ? (const unsigned char*)lodCube.getPackedData().data()
+                                                 : (const unsigned char*)lodCube.getInterleavedData().data();
+        const auto& lodIndices = lodCube.getIndices();
+        lodBaseVertex.push_back(vertexData.size() / vertexStride);
+        lodFirstIndex.push_back(indexData.size());
+        lodNumIndices.push_back(lodIndices.size());
+        vertexData.insert(vertexData.end(), lodVertices, lodVertices + lodCube.getNumVertices() * vertexStride);
+        indexData.insert(indexData.end(), lodIndices.begin(), lodIndices.end());
+
+        // estimated post-transform cache behaviour of the index order, simulated for a FIFO cache
+        // of 16 vertices; real GPUs differ, so this is no substitute for timing the cube passes
+        const size_t cacheSize = 16;
+        float hitRate = vertexCacheHitRate(lodIndices, cacheSize);
+        std::cout << "Cube LOD " << lodBaseVertex.size() - 1 << ": " << lodCube.getNumVertices() << " vertices, "
+                  << lodIndices.size() / 3 << " triangles, estimated FIFO-" << cacheSize << " cache hit rate "
+                  << hitRate * 100 << "%, vertex shader runs per triangle " << 3 * (1 - hitRate) << std::endl;
+    }
 
     glGenVertexArrays(1, &cubeVAO);
     glGenBuffers(1, &vertexVBO);
-    // fill vertex buffer
+    glGenBuffers(1, &indexEBO);
+    glBindVertexArray(cubeVAO);
+    // fill vertex and index buffers
     glBindBuffer(GL_ARRAY_BUFFER, vertexVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size() * sizeof(uint32_t), indexData.data(), GL_STATIC_DRAW);
     // position attribute
-    glBindVertexArray(cubeVAO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0); // Vertices
+    if (packedVertices) {
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, vertexStride, (void*)offsetof(PackedCubeVertex, position)); // Vertices
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, vertexStride, (void*)offsetof(PackedCubeVertex, normal)); // Normals
+        glEnableVertexAttribArray(1);
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)0); // Vertices
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)(3*sizeof(float))); // Normals
+        glEnableVertexAttribArray(1);
+    }
+    std::cout << "Cube vertex buffer: " << vertexData.size() << " bytes (" << vertexStride << " bytes per vertex)" << std::endl;
+
+    // merged outline hulls, each plane's hull is built into its own range when the plane settles
+    vector<int> hullFirstVertex, hullNumVertices;
+    vector<bool> hullBuilt(planes.size(), false);
+    size_t totalHullVertices = 0;
+    for (const auto& plane : planes) {
+        hullFirstVertex.push_back(totalHullVertices);
+        hullNumVertices.push_back(gridOutlineHullVertices(plane.cols, plane.rows));
+        totalHullVertices += hullNumVertices.back();
+    }
+    unsigned int hullVAO, hullVBO;
+    glGenVertexArrays(1, &hullVAO);
+    glGenBuffers(1, &hullVBO);
+    glBindVertexArray(hullVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, hullVBO);
+    glBufferData(GL_ARRAY_BUFFER, MERGED_OUTLINE_HULLS ? totalHullVertices * sizeof(glm::vec3) : 0, NULL, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3*sizeof(float))); // Normals
-    glEnableVertexAttribArray(1);
+
+    // impostors are generated from the instance data alone, but core profile still needs a VAO bound
+    unsigned int impostorVAO;
+    glGenVertexArrays(1, &impostorVAO);
 
     // create high res framebuffer to write to; the final display output will be an anti-aliased downscaled version of this
     // --------------------------------------------------------------------------------------------------------------------
+    // GPU memory of the render targets; RGB8 takes 4 bytes per pixel on most drivers
+    size_t renderTargetBytes = 0;
+    const size_t fbPixels = (size_t)FB_WIDTH * FB_HEIGHT;
     glGenFramebuffers(1, &framebuffer);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
@@ -270,26 +776,259 @@ int main()
     glGenTextures(1, &textureColorbuffer);
     glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, FB_WIDTH, FB_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    // the downsample pass fetches texels directly; the benchmark's mipmap path filters it through its own sampler
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glBindTexture(GL_TEXTURE_2D, 0);
 
     // attach it to currently bound framebuffer object
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorbuffer, 0);
-
-    // Create render buffer for depth and stencil buffers
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, FB_WIDTH, FB_HEIGHT);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-
-    // attach the renderbuffer object to the depth and stencil attachment of the framebuffer
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
+    renderTargetBytes += 4 * fbPixels;
+
+    // Create texture for depth and stencil buffers; a texture rather than a renderbuffer so the
+    // occlusion culling can build its depth pyramid from it. With MSAA the framebuffer only
+    // receives the resolved colors
+    if (!MSAA) {
+        glGenTextures(1, &depthbuffer);
+        glBindTexture(GL_TEXTURE_2D, depthbuffer);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, FB_WIDTH, FB_HEIGHT, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // attach the depth texture to the depth and stencil attachment of the framebuffer
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthbuffer, 0);
+        renderTargetBytes += 4 * fbPixels;
+    }
 
     // check if the framebuffer is complete now, so we can render to it
     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
 
+    // visibility buffer of the cube passes; shares the depth texture with the framebuffer,
+    // which receives the shaded colors of the resolve pass
+    // ------------------------------------------------------------------------------------
+    auto createVisibilityFramebuffer = [&](unsigned int& fbo, unsigned int& texture, unsigned int depth) {
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, FB_WIDTH, FB_HEIGHT, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Visibility framebuffer is not complete!" << std::endl;
+        renderTargetBytes += 4 * fbPixels;
+    };
+    if (VISIBILITY_BUFFER) {
+        createVisibilityFramebuffer(visFramebuffer, visibilitybuffer, depthbuffer);
+    }
+
+    // multisampled color and depth of the cube passes with MSAA, resolved into the framebuffer
+    // ------------------------------------------------------------------------------------------
+    auto createMultisampleFramebuffer = [&](unsigned int& fbo, unsigned int& color, unsigned int& depth) {
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glGenTextures(1, &color);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, color);
+        glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, MSAA_SAMPLES, GL_RGB8, FB_WIDTH, FB_HEIGHT, GL_TRUE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, color, 0);
+        glGenTextures(1, &depth);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, depth);
+        glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, MSAA_SAMPLES, GL_DEPTH24_STENCIL8, FB_WIDTH, FB_HEIGHT, GL_TRUE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D_MULTISAMPLE, depth, 0);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Multisampled framebuffer is not complete!" << std::endl;
+        renderTargetBytes += 2 * 4 * MSAA_SAMPLES * fbPixels;
+    };
+    if (MSAA) {
+        createMultisampleFramebuffer(msaaFramebuffer, msaaColorbuffer, msaaDepthbuffer);
+    }
+
+    // running average of the jittered passes with accumulation, read by the downsample pass
+    // --------------------------------------------------------------------------------------
+    if (ACCUMULATION) {
+        glGenTextures(1, &accumulationTexture);
+        glBindTexture(GL_TEXTURE_2D, accumulationTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, FB_WIDTH, FB_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        renderTargetBytes += 4 * sizeof(float) * fbPixels;
+    }
+    const unsigned int downsampleSource = ACCUMULATION ? accumulationTexture : textureColorbuffer;
+
+    // output tile at its final resolution, written by the downsample pass and read back to save frames
+    // ----------------------------------------------------------------------------------------------
+    auto createOutputTexture = [&](unsigned int& texture) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, TILE_OUTPUT_WIDTH, TILE_OUTPUT_HEIGHT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    };
+    createOutputTexture(outputTexture);
+    renderTargetBytes += 4 * (size_t)TILE_OUTPUT_WIDTH * TILE_OUTPUT_HEIGHT;
+    glGenFramebuffers(1, &outputFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, outputTexture, 0);
+
+    // luma and chroma planes of the output tile without its border, read back instead of the output texture
+    // for 4:2:0 sinks
+    unsigned int lumaTexture = 0, chromaTexture = 0;
+    if (YUV_READBACK) {
+        glGenTextures(1, &lumaTexture);
+        glBindTexture(GL_TEXTURE_2D, lumaTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, tileWidth, tileHeight);
+        glGenTextures(1, &chromaTexture);
+        glBindTexture(GL_TEXTURE_2D, chromaTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG8, tileWidth / 2, tileHeight / 2);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        renderTargetBytes += (size_t)tileWidth * tileHeight * 3 / 2;
+    }
+
+    // outputs of the other downsample paths, compared against each other by the benchmark
+    const vector<string> benchmarkPaths = {"box", "lanczos", "mipmap"};
+    vector<unsigned int> benchmarkTextures(benchmarkPaths.size(), 0);
+    unsigned int benchmarkFramebuffer = 0;
+    // the benchmark waits for its queries and readbacks, it measures rather than renders
+    GLuint benchmarkQuery;
+    glGenQueries(1, &benchmarkQuery);
+    // trilinear filtering for the mipmap path only; with a mipmap filter in the texture itself, the
+    // framebuffer would be mipmap-incomplete, and read as black, until the first glGenerateMipmap
+    GLuint benchmarkSampler;
+    glGenSamplers(1, &benchmarkSampler);
+    glSamplerParameteri(benchmarkSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glSamplerParameteri(benchmarkSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (settings.downsampleBenchmark) {
+        for (auto& texture : benchmarkTextures) {
+            createOutputTexture(texture);
+        }
+        glGenFramebuffers(1, &benchmarkFramebuffer);
+    }
+
+    // SSAA frames the accumulation benchmark compares against, and its partially accumulated output
+    std::ifstream accumulationReference;
+    unsigned int accumulationBenchmarkTexture = 0;
+    if (!settings.accumulationBenchmark.empty()) {
+        accumulationReference.open(settings.accumulationBenchmark, std::ios::binary);
+        if (!accumulationReference)
+            std::cout << "ERROR::BENCHMARK:: Could not open the reference frames " << settings.accumulationBenchmark << std::endl;
+        createOutputTexture(accumulationBenchmarkTexture);
+    }
+
+    // persistent layer of the settled planes, copied into the framebuffer at the start of every frame
+    // --------------------------------------------------------------------------------------------------
+    if (INCREMENTAL_RENDERING && MSAA) {
+        // same samples as the multisampled framebuffer so it can be blitted
+        createMultisampleFramebuffer(cacheFramebuffer, cacheColorbuffer, cacheDepthbuffer);
+    } else if (INCREMENTAL_RENDERING) {
+        glGenFramebuffers(1, &cacheFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, cacheFramebuffer);
+
+        glGenTextures(1, &cacheColorbuffer);
+        glBindTexture(GL_TEXTURE_2D, cacheColorbuffer);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, FB_WIDTH, FB_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cacheColorbuffer, 0);
+
+        // same format as the framebuffer's depth so it can be blitted
+        glGenTextures(1, &cacheDepthbuffer);
+        glBindTexture(GL_TEXTURE_2D, cacheDepthbuffer);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, FB_WIDTH, FB_HEIGHT, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, cacheDepthbuffer, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Cache framebuffer is not complete!" << std::endl;
+        renderTargetBytes += 2 * 4 * fbPixels;
+
+        if (VISIBILITY_BUFFER) {
+            createVisibilityFramebuffer(cacheVisFramebuffer, cacheVisibilitybuffer, cacheDepthbuffer);
+        }
+    }
+
+    // hierarchical-Z pyramid and buffers of the occlusion culling pass
+    // ---------------------------------------------------------------
+    // level 0 has half the framebuffer resolution and stores the farthest depth of every 2x2 pixels
+    vector<glm::ivec2> hiZSizes;
+    for (glm::ivec2 size(FB_WIDTH / 2, FB_HEIGHT / 2); ; size = glm::max(size / 2, glm::ivec2(1))) {
+        hiZSizes.push_back(size);
+        if (size.x == 1 && size.y == 1) break;
+    }
+    GLuint visibleInstanceBuffer = 0, elementsCommandBuffer = 0, arraysCommandBuffer = 0, cullStatsBuffer = 0;
+    if (OCCLUSION_CULLING) {
+        glGenTextures(1, &hiZTexture);
+        glBindTexture(GL_TEXTURE_2D, hiZTexture);
+        glTexStorage2D(GL_TEXTURE_2D, hiZSizes.size(), GL_R32F, hiZSizes[0].x, hiZSizes[0].y);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        for (const auto& size : hiZSizes) {
+            renderTargetBytes += sizeof(float) * size.x * size.y;
+        }
+
+        // every draw run appends its visible instances to its own segment, starting at the run's first
+        // instance; the segments of the still instances follow those of the transition instances
+        glGenBuffers(1, &visibleInstanceBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleInstanceBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (numCubes + instanceDataStill.size()) * sizeof(int), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, visibleInstanceBuffer);
+
+        // at most one transition run and two still runs per plane
+        glGenBuffers(1, &elementsCommandBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, elementsCommandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 3 * planes.size() * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, elementsCommandBuffer);
+
+        glGenBuffers(1, &arraysCommandBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, arraysCommandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 3 * planes.size() * sizeof(DrawArraysIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, arraysCommandBuffer);
+
+        // tested and occluded cubes per layer, each for the transition and the still cubes
+        glGenBuffers(1, &cullStatsBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, cullStatsBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 4 * MAX_LAYERS * sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, cullStatsBuffer);
+    }
+
+    // framebuffer of the software rasterizer, a depth and a color per pixel
+    GLuint softRasterBuffer = 0;
+    if (SOFT_RASTER_THRESHOLD > 0.0f) {
+        glGenBuffers(1, &softRasterBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, softRasterBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)FB_WIDTH * FB_HEIGHT * 2 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, softRasterBuffer);
+        renderTargetBytes += 2 * sizeof(GLuint) * fbPixels;
+    }
+    std::cout << "Render targets: " << renderTargetBytes / (1024.0 * 1024.0) << " MiB, " << antiAliasingName(settings.antiAliasing);
+    if (MSAA) {
+        std::cout << " " << MSAA_SAMPLES << "x at " << settings.supersampling << "x output";
+    } else if (ACCUMULATION) {
+        std::cout << " of " << ACCUMULATION_PASSES << " passes at " << settings.supersampling << "x output";
+    } else {
+        std::cout << " " << settings.supersampling << "x" << settings.supersampling;
+    }
+    std::cout << std::endl;
+
+    // indirect commands of the draws built on the CPU every frame; room for one command per plane
+    // in every pass (outlines and colored cubes of the cache, still and transition draws, and slabs)
+    const size_t maxDrawCommands = 16 * planes.size();
+    GLuint drawCommandBuffer;
+    glGenBuffers(1, &drawCommandBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, maxDrawCommands * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
     // unbind buffer, rendering to display again
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -323,30 +1062,212 @@ int main()
 
     // render loop
     // -----------
-    bool saveFrame = true;
     int frameCount = 0;
-    int startFrame = 0;
+    int startFrame = settings.startFrame;
     auto startTime = chrono::steady_clock::now();
     float currentTime, prevTime;
-    float fps = 60.;
-    float maxTime = ((float)startFrame/fps) + 40;
+    float maxTime = settings.frames > 0 ? (float)(startFrame + settings.frames) / fps : ((float)startFrame/fps) + 40;
+    int framesRendered = 0;
+    int framesRepeated = 0;
+
+    // frames in a span of the timeline where nothing changes are copies of the first one
+    const auto staticIntervals = timeline.staticIntervals((float)startFrame / fps, maxTime);
+    float staticSeconds = 0.0f;
+    for (const auto& interval : staticIntervals) {
+        staticSeconds += interval.end - interval.start;
+    }
+    std::cout << "Timeline: " << staticIntervals.size() << " static intervals, " << staticSeconds << " s of "
+              << maxTime - (float)startFrame / fps << " s" << std::endl;
+
+    // planes drawn into the cache layer, and the camera they were drawn with
+    vector<bool> planeCached(planes.size(), false);
+    glm::mat4 cacheView(0.0f), cacheProjection(0.0f);
+    bool hiZDirty = true;
+
+    const glm::vec2 depthRange(0.1f, 1000.0f);
+    // frames are assembled from their tiles in a ring of pixel pack buffers, in the sink's pixel order, and
+    // only mapped once the two frames after them have been submitted, so the readback never stalls the GPU
+    const int READBACK_RING_SIZE = 3;
+    vector<ReadbackSlot> readbackSlots(READBACK_RING_SIZE);
+    if (saveFrame && !DIRECT_READBACK) {
+        for (auto& slot : readbackSlots) {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    // GPU time spent in the cube passes (including the MSAA resolve and accumulation, one query per
+    // accumulation pass), the downsample and the software rasterizer, and the culling statistics; in a
+    // ring of the readback's size, so frame N-2 is reported while frame N is rendered
+    const size_t cullStatsBytes = 4 * MAX_LAYERS * sizeof(GLuint);
+    vector<GpuStatsSlot> statsSlots(READBACK_RING_SIZE);
+    for (auto& slot : statsSlots) {
+        slot.cubePassQueries.resize(tiles.size() * ACCUMULATION_PASSES);
+        glGenQueries(slot.cubePassQueries.size(), slot.cubePassQueries.data());
+        slot.downsampleQueries.resize(tiles.size());
+        glGenQueries(slot.downsampleQueries.size(), slot.downsampleQueries.data());
+        slot.softRasterQueries.resize(2 * tiles.size());
+        glGenQueries(slot.softRasterQueries.size(), slot.softRasterQueries.data());
+        slot.softRasterUsed.assign(tiles.size(), 0);
+        slot.culled.assign(tiles.size(), 0);
+        if (cullStatsBuffer) {
+            glGenBuffers(1, &slot.cullStatsBuffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, slot.cullStatsBuffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, tiles.size() * cullStatsBytes, NULL, GL_STREAM_READ);
+        }
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    // prints the frame's GPU statistics; unless wait is set, a frame whose results are not ready yet is skipped
+    auto reportGpuStats = [&](GpuStatsSlot& slot, bool wait) {
+        bool ready = true;
+        if (wait) {
+            while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+        } else {
+            ready = glClientWaitSync(slot.fence, 0, 0) != GL_TIMEOUT_EXPIRED;
+            for (GLuint query : slot.downsampleQueries) {
+                GLuint available = GL_FALSE;
+                glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+                ready = ready && available;
+            }
+        }
+        if (!ready) {
+            std::cout << "GPU times of frame " << slot.frame << " not ready, skipped" << std::endl;
+        } else {
+            vector<GLuint> cullStats;
+            if (slot.cullStatsBuffer) {
+                cullStats.resize(tiles.size() * 4 * MAX_LAYERS);
+                glBindBuffer(GL_COPY_READ_BUFFER, slot.cullStatsBuffer);
+                glGetBufferSubData(GL_COPY_READ_BUFFER, 0, tiles.size() * cullStatsBytes, cullStats.data());
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            }
+            std::cout << "GPU times of frame " << slot.frame << ":" << std::endl;
+            for (size_t t = 0; t < tiles.size(); ++t) {
+                if (tiles.size() > 1) {
+                    std::cout << "Tile " << tiles[t].x << "," << tiles[t].y << ":" << std::endl;
+                }
+                GLuint64 cubePassNs = 0;
+                for (unsigned int pass = 0; pass < ACCUMULATION_PASSES; ++pass) {
+                    GLuint64 passNs = 0;
+                    glGetQueryObjectui64v(slot.cubePassQueries[t * ACCUMULATION_PASSES + pass], GL_QUERY_RESULT, &passNs);
+                    cubePassNs += passNs;
+                }
+                std::cout << "tCubes: " << cubePassNs * 1e-9 << " s";
+                if (ACCUMULATION_PASSES > 1) {
+                    std::cout << " in " << ACCUMULATION_PASSES << " passes";
+                }
+                std::cout << std::endl;
+                GLuint64 downsampleNs = 0;
+                glGetQueryObjectui64v(slot.downsampleQueries[t], GL_QUERY_RESULT, &downsampleNs);
+                std::cout << "tDownsample: " << downsampleNs * 1e-9 << " s" << std::endl;
+                if (slot.softRasterUsed[t]) {
+                    GLuint64 softRasterStart = 0, softRasterEnd = 0;
+                    glGetQueryObjectui64v(slot.softRasterQueries[2 * t], GL_QUERY_RESULT, &softRasterStart);
+                    glGetQueryObjectui64v(slot.softRasterQueries[2 * t + 1], GL_QUERY_RESULT, &softRasterEnd);
+                    std::cout << "tSoftRaster: " << (softRasterEnd - softRasterStart) * 1e-9 << " s (threshold "
+                              << SOFT_RASTER_THRESHOLD << " px)" << std::endl;
+                }
+                if (slot.culled[t]) {
+                    const GLuint* tileStats = cullStats.data() + t * 4 * MAX_LAYERS;
+                    for (int still = 0; still < 2; ++still) {
+                        const GLuint* tested = tileStats + still * MAX_LAYERS;
+                        const GLuint* occluded = tileStats + (2 + still) * MAX_LAYERS;
+                        if (std::all_of(tested, tested + MAX_LAYERS, [](GLuint count) { return count == 0; })) continue;
+                        std::cout << (still ? "Occluded still cubes:" : "Occluded transition cubes:");
+                        for (int layer = 0; layer < MAX_LAYERS; ++layer) {
+                            if (tested[layer] == 0) continue;
+                            std::cout << " layer " << layer << " " << occluded[layer] << "/" << tested[layer];
+                        }
+                        std::cout << std::endl;
+                    }
+                }
+            }
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+        slot.frame = -1;
+    };
+
+    const GLenum readbackFormat = sink && sink->pixelOrder() == PixelOrder::RGB ? GL_RGB : GL_BGR;
+    int framesSaved = 0;
+    // PNG size of the first saved frame at the configured level, to report the output volume against
+    // PNG files of the same frames; not needed when they are PNG files
+    const bool PNG_ESTIMATE = sink && !(settings.sink == SinkType::PNG && settings.imageFormat == ImageFormat::PNG);
+    size_t pngSampleBytes = 0;
+    int pngSampleFrame = -1;
+    auto estimatePng = [&](const unsigned char* pixels, int frame) {
+        // the PNG encoder takes the pixels as read back for the image sinks, BGR with the bottom row first
+        const int width = settings.outputWidth, height = settings.outputHeight;
+        cv::Mat bgr;
+        switch (sink->pixelOrder()) {
+        case PixelOrder::BGR:
+            bgr = cv::Mat(height, width, CV_8UC3, (void*)pixels);
+            break;
+        case PixelOrder::RGB:
+            cv::cvtColor(cv::Mat(height, width, CV_8UC3, (void*)pixels), bgr, cv::COLOR_RGB2BGR);
+            break;
+        case PixelOrder::YUV420:
+            cv::cvtColor(cv::Mat(height * 3 / 2, width, CV_8UC1, (void*)pixels), bgr, cv::COLOR_YUV2BGR_I420);
+            cv::flip(bgr, bgr, 0);
+            break;
+        }
+        std::vector<unsigned char> png;
+        encodePng(bgr.data, width, height, settings.pngCompression, settings.pngStrips, png);
+        pngSampleBytes = png.size();
+        pngSampleFrame = frame;
+    };
+    // hand a read back frame and its repeats to the encoders or the sink
+    auto writeFrame = [&](const unsigned char* pixels, int index, float time, int repeats) {
+        if (PNG_ESTIMATE && pngSampleFrame < 0) {
+            // once per run, on the render thread
+            estimatePng(pixels, index);
+        }
+        if (encoder) {
+            // waits for a free buffer when the encoders fall behind
+            EncodeFrame* frame = encoder->acquire();
+            std::copy(pixels, pixels + frameBytes, frame->pixels.begin());
+            frame->index = index;
+            frame->time = time;
+            frame->repeats = repeats;
+            encoder->submit(frame);
+        } else {
+            // streaming sinks write straight from the read back memory
+            sink->write({pixels, index, time});
+            for (int i = 1; i <= repeats; ++i) {
+                sink->repeat({pixels, index, time}, index + i, time + i / fps);
+            }
+        }
+        framesSaved += 1 + repeats;
+        cout << time << endl;
+    };
+    auto finishReadback = [&](ReadbackSlot& slot) {
+        // already signaled unless the ring is drained at the end
+        while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(slot.fence);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const auto* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+        if (!pixels) {
+            // nothing is mapped, so nothing to unmap; the frame and its repeats are dropped
+            std::cout << "ERROR::READBACK:: Could not map the pixels of frame " << slot.frame << ", GL error 0x"
+                      << std::hex << glGetError() << std::dec << std::endl;
+        } else {
+            writeFrame(pixels, slot.frame, slot.time, slot.repeats);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = 0;
+        slot.frame = -1;
+        slot.repeats = 0;
+    };
+
     while (!glfwWindowShouldClose(window))
     {
         double t0Loop = (double)cv::getTickCount();
         // first pass rendering to high res framebuffer
         // --------------------------------------------
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-
-        // update the viewport size
-        glViewport(0, 0, FB_WIDTH, FB_HEIGHT);
-
         // draw instanced cubes
-        shader.use();
         // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+        glm::mat4 frameProjection = glm::perspective(glm::radians(camera.Zoom), (float)settings.outputWidth / (float)settings.outputHeight, depthRange.x, depthRange.y);
 
         // camera/view transformation
         //glm::mat4 view = camera.GetViewMatrix();
@@ -357,43 +1278,713 @@ int main()
         glm::vec3 camUp{0.f, 1.f, 0.f};
         glm::mat4 view = glm::lookAt(camPos, camLookAt, camUp);
 
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
         prevTime = currentTime;
         // currentTime = (chrono::duration<double>(chrono::steady_clock::now() - startTime)).count();
-        currentTime = ((float) startFrame + frameCount) / fps;
-        shader.setFloat("currentTime", currentTime);
-
-        // world transformation
-        glm::mat4 model = glm::mat4(1.0f);
-        shader.setMat4("model", model);
-        glBindVertexArray(cubeVAO);
-
-        // Draw white borders
-        glCullFace(GL_FRONT);
-        shader.setBool("isOutline", true);
-        shader.setBool("isStill", false);  // Transition cubes
-        glDrawArraysInstanced(GL_TRIANGLES, 0, cube.getNumIndices(), numCubes);
-        shader.setInt("isStill", true);  // Still cubes
-        glDrawArraysInstanced(GL_TRIANGLES, 0, cube.getNumIndices(), numCubes);
-        glCullFace(GL_BACK);
-
-        // Draw colored cubes
-        shader.setBool("isOutline", false);
-        shader.setBool("isStill", false);  // Transition cubes
-        glDrawArraysInstanced(GL_TRIANGLES, 0, cube.getNumIndices(), numCubes);
-        shader.setInt("isStill", true);  // Still cubes
-        glDrawArraysInstanced(GL_TRIANGLES, 0, cube.getNumIndices(), numCubes);
-
-        //glDrawArrays(GL_TRIANGLES, 0, cube.getNumIndices());
-        glBindVertexArray(0);
-
-        // second pass rendering to screen
-        // --------------------------------
+        const float frameTime = ((float) startFrame + frameCount) / fps;
+        auto& stats = statsSlots[framesRendered % READBACK_RING_SIZE];
+        stats.frame = frameCount;
+        std::fill(stats.softRasterUsed.begin(), stats.softRasterUsed.end(), 0);
+        std::fill(stats.culled.begin(), stats.culled.end(), 0);
+        // the ring slot the frame is read back into with DIRECT_READBACK, waits for the consumer to free one;
+        // the frame is dropped without one
+        unsigned char* directPixels = saveFrame && DIRECT_READBACK ? sink->frameMemory(frameCount) : nullptr;
+        // the frame's reference for the accumulation benchmark, top row first
+        cv::Mat referenceFrame;
+        if (accumulationReference.is_open()) {
+            referenceFrame.create(settings.outputHeight, settings.outputWidth, CV_8UC3);
+            const size_t referenceBytes = referenceFrame.total() * referenceFrame.elemSize();
+            accumulationReference.seekg((std::streamoff)frameCount * referenceBytes);
+            if (!accumulationReference.read((char*)referenceFrame.data, referenceBytes)) {
+                std::cout << "ERROR::BENCHMARK:: No reference for frame " << startFrame + frameCount << std::endl;
+                accumulationReference.clear();
+                referenceFrame.release();
+            }
+        }
+        // every tile is rendered in ACCUMULATION_PASSES passes, which open the shutter at the frame's time
+        for (size_t tilePass = 0; tilePass < tiles.size() * ACCUMULATION_PASSES; ++tilePass) {
+            const size_t tileIndex = tilePass / ACCUMULATION_PASSES;
+            const auto& tile = tiles[tileIndex];
+            const unsigned int pass = tilePass % ACCUMULATION_PASSES;
+            currentTime = frameTime + SHUTTER * pass / ACCUMULATION_PASSES / fps;
+
+            // scale and shift the frame's clip space so the tile and its border fill the viewport, an
+            // off-center part of the same frustum that rasterizes exactly like the whole frame would
+            glm::vec2 tileOrigin = glm::vec2(tile.x, tile.y) - glm::vec2(tileGuard);
+            glm::vec2 tileSize(TILE_OUTPUT_WIDTH, TILE_OUTPUT_HEIGHT);
+            glm::vec2 frameSize(settings.outputWidth, settings.outputHeight);
+            glm::vec2 tileScale = frameSize / tileSize;
+            glm::vec2 tileCenter = (2.0f * tileOrigin + tileSize) / frameSize - 1.0f;
+            glm::mat4 tileMatrix(1.0f);
+            tileMatrix[0][0] = tileScale.x;
+            tileMatrix[1][1] = tileScale.y;
+            tileMatrix[3][0] = -tileScale.x * tileCenter.x;
+            tileMatrix[3][1] = -tileScale.y * tileCenter.y;
+            if (ACCUMULATION) {
+                // shift every pass by its own sub-pixel offset from the Halton sequence, which stays
+                // evenly spread within the pixel for any number of passes
+                glm::vec2 jitter(halton(pass + 1, 2) - 0.5f, halton(pass + 1, 3) - 0.5f);
+                tileMatrix[3][0] += 2.0f * jitter.x / FB_WIDTH;
+                tileMatrix[3][1] += 2.0f * jitter.y / FB_HEIGHT;
+            }
+            glm::mat4 projection = tileMatrix * frameProjection;
+            glm::vec2 viewportSize(FB_WIDTH, FB_HEIGHT);
+
+            // world transformation
+            glm::mat4 model = glm::mat4(1.0f);
+
+            shader.use();
+            shader.setMat4("projection", projection);
+            shader.setMat4("view", view);
+            shader.setMat4("model", model);
+            shader.setFloat("currentTime", currentTime);
+            shader.setFloat("sphereness", SPHERENESS);
+            shader.setFloat("positionScale", packedVertices ? cubeLods[0].getPackedPositionScale() : 1.0f);
+            shader.setFloat("impostorThreshold", IMPOSTOR_THRESHOLD);
+            shader.setVec2("viewportSize", viewportSize);
+
+            impostorShader.use();
+            impostorShader.setMat4("projection", projection);
+            impostorShader.setMat4("view", view);
+            impostorShader.setMat4("invViewProjection", glm::inverse(projection * view));
+            impostorShader.setVec3("cameraPos", camPos);
+            impostorShader.setFloat("currentTime", currentTime);
+            impostorShader.setFloat("impostorThreshold", IMPOSTOR_THRESHOLD);
+            impostorShader.setVec2("viewportSize", viewportSize);
+
+            hullShader.use();
+            hullShader.setMat4("projection", projection);
+            hullShader.setMat4("view", view);
+            hullShader.setMat4("model", model);
+            hullShader.setBool("isOutline", true);
+
+            slabShader.use();
+            slabShader.setMat4("projection", projection);
+            slabShader.setMat4("view", view);
+            slabShader.setVec3("cameraPos", camPos);
+            slabShader.setFloat("positionScale", packedVertices ? cubeLods[0].getPackedPositionScale() : 1.0f);
+
+            // the cache layer stays valid for as long as the camera does not change
+            bool cacheValid = INCREMENTAL_RENDERING && view == cacheView && projection == cacheProjection;
+            if (INCREMENTAL_RENDERING && !cacheValid) {
+                std::fill(planeCached.begin(), planeCached.end(), false);
+                cacheView = view;
+                cacheProjection = projection;
+            }
+
+            // reject whole planes that are outside the view or have nothing to show at this time, then
+            // split the rest between cube meshes and impostors by projected size; the shaders make the
+            // final choice per instance, planes entirely on one side of the threshold skip the other path
+            Frustum frustum(projection * view);
+            PassDraws stillDraws, transDraws, cacheDraws;
+            int numStillPlanes = 0;
+            size_t hullTriangles = 0, replacedOutlineTriangles = 0;
+            size_t stillCubes = 0, stillImageCubes = 0;
+            for (size_t planeIdx = 0; planeIdx < planes.size(); ++planeIdx) {
+                const auto& plane = planes[planeIdx];
+                bool transActive = plane.transStartTime <= currentTime && currentTime <= plane.transEndTime;
+                bool settled = currentTime >= plane.time;
+                // the still cubes of a plane all arrive at once, before that the plane shows nothing
+                bool drawStill = settled && !(INCREMENTAL_RENDERING && planeCached[planeIdx]);
+                transActive = transActive && frustum.intersects(plane.transBboxMin, plane.transBboxMax);
+                drawStill = drawStill && frustum.intersects(plane.bboxMin, plane.bboxMax);
+                if (!transActive && !drawStill) continue;
+
+                glm::vec2 sizeRange = projectedCubeSizeRange(plane, view, projection, FB_HEIGHT);
+                // assign every plane the coarsest cube mesh that holds up at its projected size
+                int lod = selectCubeLod(sizeRange.y, SPHERENESS);
+                // transition cubes leave their plane, so they always go through both paths
+                if (transActive) {
+                    transDraws.mesh.push_back({lod, plane.firstInstance, plane.numInstances, false, 1.0f, (int)planeIdx});
+                    transDraws.impostor.push_back({0, plane.firstInstance, plane.numInstances, false, 1.0f, (int)planeIdx});
+                    if (SOFT_RASTER_THRESHOLD > 0.0f) transDraws.splats.push_back({0, plane.firstInstance, plane.numInstances, false, 1.0f, (int)planeIdx});
+                }
+                if (!drawStill) continue;
+                ++numStillPlanes;
+
+                // settled planes go into the cache layer once and are not drawn again after that
+                PassDraws* target = &stillDraws;
+                if (INCREMENTAL_RENDERING) {
+                    planeCached[planeIdx] = true;
+                    target = &cacheDraws;
+                }
+                if (SETTLED_PLANE_SLABS) {
+                    target->slabs.push_back({0, (int)planeIdx, 1});
+                    continue;
+                }
+                // coarsest pyramid level whose merged cubes stay within the error threshold
+                int mipLevel = 0;
+                while (mipLevel + 1 < PLANE_MIP_LEVELS &&
+                       (1 << (mipLevel + 1)) * sizeRange.y <= PLANE_MIP_THRESHOLD * settings.supersampling) {
+                    ++mipLevel;
+                }
+                const PlaneMip& mip = plane.mips[mipLevel];
+                float cubeSize = 1 << mipLevel;
+                lod = selectCubeLod(sizeRange.y * cubeSize, SPHERENESS);
+                stillCubes += mip.numInstances + mip.edgeNumInstances;
+                stillImageCubes += plane.numInstances;
+
+                // the hull outlines the image cubes, coarse levels draw the outlines of their own cubes
+                bool hullOutline = MERGED_OUTLINE_HULLS && mipLevel == 0;
+                if (hullOutline) {
+                    if (!hullBuilt[planeIdx]) {
+                        const auto& firstCube = instanceDataStill[plane.firstInstance];
+                        glm::vec3 origin(firstCube.position[0], firstCube.position[1], firstCube.position[2]);
+                        vector<glm::vec3> hull = gridOutlineHull(origin, plane.cols, plane.rows);
+                        glBindBuffer(GL_ARRAY_BUFFER, hullVBO);
+                        glBufferSubData(GL_ARRAY_BUFFER, hullFirstVertex[planeIdx] * sizeof(glm::vec3), hull.size() * sizeof(glm::vec3), hull.data());
+                        hullBuilt[planeIdx] = true;
+                    }
+                    target->hulls.push_back(planeIdx);
+                    hullTriangles += hullNumVertices[planeIdx] / 3;
+                    replacedOutlineTriangles += (size_t)plane.numInstances * lodNumIndices[lod] / 3;
+                }
+                // the merged cubes, then the image cubes of the partial blocks at the plane's edges
+                const CubeDraw runs[2] = {{lod, mip.firstInstance, mip.numInstances, hullOutline, cubeSize, (int)planeIdx},
+                                          {0, mip.edgeFirstInstance, mip.edgeNumInstances, false, 1.0f, (int)planeIdx}};
+                for (CubeDraw run : runs) {
+                    if (run.numInstances == 0) continue;
+                    glm::vec2 runSizeRange = sizeRange * run.cubeSize;
+                    run.lod = selectCubeLod(runSizeRange.y, SPHERENESS);
+                    if (runSizeRange.y >= IMPOSTOR_THRESHOLD) target->mesh.push_back(run);
+                    if (runSizeRange.x < IMPOSTOR_THRESHOLD) target->impostor.push_back({0, run.firstInstance, run.numInstances, run.hullOutline, run.cubeSize, run.plane});
+                    if (target == &stillDraws && runSizeRange.x < SOFT_RASTER_THRESHOLD) target->splats.push_back({0, run.firstInstance, run.numInstances, false, run.cubeSize, run.plane});
+                }
+            }
+
+            // the still cubes of the planes nearest to the camera are drawn first; those of the
+            // planes behind them are occlusion-culled against the depth they leave
+            PassDraws occludedDraws;
+            if (OCCLUSION_CULLING) {
+                vector<pair<float, int>> planeDistances;
+                vector<char> listed(planes.size(), 0);
+                for (const auto* draws : {&stillDraws.mesh, &stillDraws.impostor}) {
+                    for (const auto& draw : *draws) {
+                        if (listed[draw.plane]) continue;
+                        listed[draw.plane] = 1;
+                        const auto& plane = planes[draw.plane];
+                        glm::vec3 outside = glm::max(glm::max(plane.bboxMin - camPos, camPos - plane.bboxMax), glm::vec3(0.0f));
+                        planeDistances.push_back({glm::length(outside), draw.plane});
+                    }
+                }
+                std::sort(planeDistances.begin(), planeDistances.end());
+                vector<char> occluder(planes.size(), 0);
+                for (size_t i = 0; i < planeDistances.size() && i < (size_t)OCCLUDER_PLANES; ++i) {
+                    occluder[planeDistances[i].second] = 1;
+                }
+                auto moveOccluded = [&](vector<CubeDraw>& from, vector<CubeDraw>& to) {
+                    auto occluded = std::stable_partition(from.begin(), from.end(), [&](const CubeDraw& draw) { return occluder[draw.plane]; });
+                    to.assign(occluded, from.end());
+                    from.erase(occluded, from.end());
+                };
+                moveOccluded(stillDraws.mesh, occludedDraws.mesh);
+                moveOccluded(stillDraws.impostor, occludedDraws.impostor);
+                moveOccluded(stillDraws.splats, occludedDraws.splats);
+            }
+
+            // all draws below go through multi-draw-indirect with one command per plane; commands
+            // built on the CPU are appended to drawCommandBuffer, which is orphaned every frame
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, maxDrawCommands * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+            size_t drawCommandOffset = 0;
+            auto multiDrawMeshes = [&](const vector<CubeDraw>& draws, bool slabs) {
+                vector<DrawElementsIndirectCommand> commands;
+                for (const auto& draw : draws) {
+                    commands.push_back({(GLuint)lodNumIndices[draw.lod], (GLuint)(slabs ? 1 : draw.numInstances),
+                                        (GLuint)lodFirstIndex[draw.lod], lodBaseVertex[draw.lod], (GLuint)draw.firstInstance});
+                }
+                size_t size = commands.size() * sizeof(DrawElementsIndirectCommand);
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+                glBufferSubData(GL_DRAW_INDIRECT_BUFFER, drawCommandOffset, size, commands.data());
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)drawCommandOffset, commands.size(), 0);
+                drawCommandOffset += size;
+            };
+            auto multiDrawArrays = [&](GLenum mode, const vector<DrawArraysIndirectCommand>& commands) {
+                size_t size = commands.size() * sizeof(DrawArraysIndirectCommand);
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+                glBufferSubData(GL_DRAW_INDIRECT_BUFFER, drawCommandOffset, size, commands.data());
+                glMultiDrawArraysIndirect(mode, (void*)drawCommandOffset, commands.size(), 0);
+                drawCommandOffset += size;
+            };
+            auto multiDrawImpostors = [&](const vector<CubeDraw>& draws) {
+                vector<DrawArraysIndirectCommand> commands;
+                for (const auto& draw : draws) {
+                    commands.push_back({4, (GLuint)draw.numInstances, 0, (GLuint)draw.firstInstance});
+                }
+                multiDrawArrays(GL_TRIANGLE_STRIP, commands);
+            };
+            // draws of cubes of one size share a multi-draw, the size is a uniform
+            auto forEachCubeSize = [](const vector<CubeDraw>& draws, const std::function<void(float, const vector<CubeDraw>&)>& drawSized) {
+                map<float, vector<CubeDraw>> bySize;
+                for (const auto& draw : draws) {
+                    bySize[draw.cubeSize].push_back(draw);
+                }
+                for (const auto& sized : bySize) {
+                    drawSized(sized.first, sized.second);
+                }
+            };
+            // the cubes of planes with a merged hull only take part in the colored pass
+            auto withoutHullOutlines = [](const vector<CubeDraw>& draws) {
+                vector<CubeDraw> kept;
+                std::copy_if(draws.begin(), draws.end(), std::back_inserter(kept), [](const CubeDraw& draw) { return !draw.hullOutline; });
+                return kept;
+            };
+            auto drawCubes = [&](bool isOutline, bool isStill, const PassDraws& draws) {
+                shader.use();
+                shader.setBool("isOutline", isOutline);
+                shader.setBool("isStill", isStill);
+                shader.setBool("culledInstances", draws.culled);
+                glBindVertexArray(cubeVAO);
+                if (draws.culled) {
+                    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, elementsCommandBuffer);
+                    for (const auto& runs : draws.culledRuns) {
+                        if (isOutline && runs.hullOutline) continue;
+                        shader.setFloat("cubeSize", runs.cubeSize);
+                        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(runs.firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                                    runs.numCommands, 0);
+                    }
+                } else {
+                    forEachCubeSize(isOutline ? withoutHullOutlines(draws.mesh) : draws.mesh, [&](float cubeSize, const vector<CubeDraw>& sized) {
+                        shader.setFloat("cubeSize", cubeSize);
+                        multiDrawMeshes(sized, false);
+                    });
+                }
+
+                impostorShader.use();
+                impostorShader.setBool("isOutline", isOutline);
+                impostorShader.setBool("isStill", isStill);
+                impostorShader.setBool("culledInstances", draws.culled);
+                // without splats in this pass, no cube is below the software raster threshold
+                impostorShader.setFloat("softRasterThreshold", draws.splats.empty() ? 0.0f : SOFT_RASTER_THRESHOLD);
+                glBindVertexArray(impostorVAO);
+                if (draws.culled) {
+                    // the culled impostor commands are at the same indices as the mesh commands
+                    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, arraysCommandBuffer);
+                    for (const auto& runs : draws.culledRuns) {
+                        if (isOutline && runs.hullOutline) continue;
+                        impostorShader.setFloat("cubeSize", runs.cubeSize);
+                        glMultiDrawArraysIndirect(GL_TRIANGLE_STRIP, (void*)(runs.firstCommand * sizeof(DrawArraysIndirectCommand)), runs.numCommands, 0);
+                    }
+                } else {
+                    forEachCubeSize(isOutline ? withoutHullOutlines(draws.impostor) : draws.impostor, [&](float cubeSize, const vector<CubeDraw>& sized) {
+                        impostorShader.setFloat("cubeSize", cubeSize);
+                        multiDrawImpostors(sized);
+                    });
+                }
+            };
+
+            auto drawSlabs = [&](const PassDraws& draws) {
+                slabShader.use();
+                glBindVertexArray(cubeVAO);
+                if (!draws.slabs.empty()) {
+                    multiDrawMeshes(draws.slabs, true);
+                }
+            };
+
+            auto drawHulls = [&](const PassDraws& draws) {
+                if (draws.hulls.empty()) return;
+                hullShader.use();
+                glBindVertexArray(hullVAO);
+                vector<DrawArraysIndirectCommand> commands;
+                for (int planeIdx : draws.hulls) {
+                    commands.push_back({(GLuint)hullNumVertices[planeIdx], 1, (GLuint)hullFirstVertex[planeIdx], 0});
+                }
+                multiDrawArrays(GL_TRIANGLES, commands);
+            };
+
+            auto drawPlanes = [&](const PassDraws& still, const PassDraws& trans) {
+                // Draw white borders
+                glCullFace(GL_FRONT);
+                drawCubes(true, false, trans);  // Transition cubes
+                drawCubes(true, true, still);  // Still cubes
+                drawHulls(still);  // Settled planes
+                glCullFace(GL_BACK);
+
+                // Draw colored cubes
+                drawCubes(false, false, trans);  // Transition cubes
+                drawCubes(false, true, still);  // Still cubes
+
+                // Settled planes, borders included
+                drawSlabs(still);
+            };
+
+            glEnable(GL_DEPTH_TEST);
+            // update the viewport size
+            glViewport(0, 0, FB_WIDTH, FB_HEIGHT);
+            glBeginQuery(GL_TIME_ELAPSED, stats.cubePassQueries[tilePass]);
+
+            // the cube passes draw colors into the framebuffer, or its multisampled counterpart, or
+            // visibility texels that are shaded below
+            const glm::vec4 backgroundColor(0.9f, 0.9f, 0.9f, 1.0f);
+            unsigned int colorFramebuffer = MSAA ? msaaFramebuffer : framebuffer;
+            unsigned int cubeFramebuffer = VISIBILITY_BUFFER ? visFramebuffer : colorFramebuffer;
+            unsigned int cubeCacheFramebuffer = VISIBILITY_BUFFER ? cacheVisFramebuffer : cacheFramebuffer;
+            auto clearCubeFramebuffer = [&]() {
+                if (VISIBILITY_BUFFER) {
+                    const GLuint background = 0;
+                    glClearBufferuiv(GL_COLOR, 0, &background);
+                    glClear(GL_DEPTH_BUFFER_BIT);
+                } else {
+                    glClearColor(backgroundColor.x, backgroundColor.y, backgroundColor.z, backgroundColor.w);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                }
+            };
+
+            if (INCREMENTAL_RENDERING) {
+                // add the newly settled planes to the cache layer and start the frame from a copy of it
+                glBindFramebuffer(GL_FRAMEBUFFER, cubeCacheFramebuffer);
+                if (!cacheValid) {
+                    clearCubeFramebuffer();
+                }
+                drawPlanes(cacheDraws, PassDraws());
+
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, cubeCacheFramebuffer);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cubeFramebuffer);
+                glBlitFramebuffer(0, 0, FB_WIDTH, FB_HEIGHT, 0, 0, FB_WIDTH, FB_HEIGHT, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+                glBindFramebuffer(GL_FRAMEBUFFER, cubeFramebuffer);
+            } else {
+                glBindFramebuffer(GL_FRAMEBUFFER, cubeFramebuffer);
+                clearCubeFramebuffer();
+            }
+
+            // everything that is not settled yet
+            drawPlanes(stillDraws, PassDraws());
+
+            // the depth pyramid only changes with the cache layer when rendering incrementally
+            if (!INCREMENTAL_RENDERING || !cacheValid || !cacheDraws.mesh.empty() || !cacheDraws.impostor.empty() || !cacheDraws.slabs.empty()) {
+                hiZDirty = true;
+            }
+            // max-depth pyramid of everything drawn so far
+            auto buildHiZ = [&]() {
+                if (!hiZDirty) return;
+                hiZDirty = false;
+                hiZShader.use();
+                hiZShader.setInt("srcDepth", 0);
+                glActiveTexture(GL_TEXTURE0);
+                for (size_t level = 0; level < hiZSizes.size(); ++level) {
+                    glBindTexture(GL_TEXTURE_2D, level == 0 ? depthbuffer : hiZTexture);
+                    hiZShader.setInt("srcLevel", level == 0 ? 0 : level - 1);
+                    glBindImageTexture(0, hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+                    glDispatchCompute((hiZSizes[level].x + 7) / 8, (hiZSizes[level].y + 7) / 8, 1);
+                    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+                }
+            };
+            // one indirect command of each kind per run of draws, from firstCommand on, whose instance counts
+            // the culling pass fills in; the shaders choose between mesh and impostor per instance, so
+            // every run goes through both
+            auto cullRuns = [&](PassDraws& draws, bool isStill, int firstCommand) {
+                // a run can be listed for both paths, the mesh draw has its LOD
+                map<int, CubeDraw> runsByInstance;
+                for (const auto& draw : draws.impostor) runsByInstance[draw.firstInstance] = draw;
+                for (const auto& draw : draws.mesh) runsByInstance[draw.firstInstance] = draw;
+                map<pair<float, bool>, vector<CubeDraw>> groups;
+                for (const auto& run : runsByInstance) {
+                    groups[{run.second.cubeSize, run.second.hullOutline}].push_back(run.second);
+                }
+
+                vector<CubeDraw> runs;
+                vector<DrawElementsIndirectCommand> elementsCommands;
+                vector<DrawArraysIndirectCommand> arraysCommands;
+                const GLuint segmentOffset = isStill ? numCubes : 0;
+                for (const auto& group : groups) {
+                    draws.culledRuns.push_back({firstCommand + (int)runs.size(), (int)group.second.size(), group.first.first, group.first.second});
+                    for (const auto& run : group.second) {
+                        runs.push_back(run);
+                        elementsCommands.push_back({(GLuint)lodNumIndices[run.lod], 0, (GLuint)lodFirstIndex[run.lod],
+                                                    lodBaseVertex[run.lod], segmentOffset + run.firstInstance});
+                        arraysCommands.push_back({4, 0, 0, segmentOffset + run.firstInstance});
+                    }
+                }
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, elementsCommandBuffer);
+                glBufferSubData(GL_SHADER_STORAGE_BUFFER, firstCommand * sizeof(DrawElementsIndirectCommand),
+                                elementsCommands.size() * sizeof(DrawElementsIndirectCommand), elementsCommands.data());
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, arraysCommandBuffer);
+                glBufferSubData(GL_SHADER_STORAGE_BUFFER, firstCommand * sizeof(DrawArraysIndirectCommand),
+                                arraysCommands.size() * sizeof(DrawArraysIndirectCommand), arraysCommands.data());
+
+                cullShader.use();
+                cullShader.setInt("hiZ", 0);
+                cullShader.setMat4("view", view);
+                cullShader.setMat4("projection", projection);
+                cullShader.setVec2("viewportSize", viewportSize);
+                cullShader.setFloat("currentTime", currentTime);
+                cullShader.setBool("isStill", isStill);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, hiZTexture);
+                for (size_t i = 0; i < runs.size(); ++i) {
+                    cullShader.setInt("firstInstance", runs[i].firstInstance);
+                    cullShader.setInt("numInstances", runs[i].numInstances);
+                    cullShader.setFloat("cubeSize", runs[i].cubeSize);
+                    cullShader.setInt("layer", planes[runs[i].plane].layer);
+                    cullShader.setInt("drawRun", firstCommand + i);
+                    glDispatchCompute((runs[i].numInstances + 63) / 64, 1, 1);
+                }
+                glBindTexture(GL_TEXTURE_2D, 0);
+                glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+                draws.culled = true;
+            };
+
+            bool cullStill = !occludedDraws.mesh.empty() || !occludedDraws.impostor.empty();
+            bool cullTrans = OCCLUSION_CULLING && !transDraws.mesh.empty();
+            if (cullStill || cullTrans) {
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, cullStatsBuffer);
+                glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+            }
+            // drop the still cubes of the farther planes hidden behind the nearest ones; their
+            // commands follow those of the transition runs
+            if (cullStill) {
+                buildHiZ();
+                cullRuns(occludedDraws, true, transDraws.mesh.size());
+                drawPlanes(occludedDraws, PassDraws());
+                hiZDirty = true;
+            }
+            // drop the transition cubes hidden behind everything drawn so far
+            if (cullTrans) {
+                buildHiZ();
+                cullRuns(transDraws, false, 0);
+            }
+
+            drawPlanes(PassDraws(), transDraws);
+
+            if (VISIBILITY_BUFFER) {
+                // shade every framebuffer pixel once from the instance and face that cover it
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+                glDisable(GL_DEPTH_TEST);
+                resolveShader.use();
+                resolveShader.setInt("visibility", 0);
+                resolveShader.setFloat("currentTime", currentTime);
+                resolveShader.setVec4("backgroundColor", backgroundColor);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, visibilitybuffer);
+                glBindVertexArray(quadVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                glBindTexture(GL_TEXTURE_2D, 0);
+            }
+
+            // splat the smallest cubes in a compute pass and depth-test them into the framebuffer
+            bool softRasterUsed = !stillDraws.splats.empty() || !occludedDraws.splats.empty() || !transDraws.splats.empty();
+            stats.softRasterUsed[tileIndex] = softRasterUsed;
+            if (softRasterUsed) {
+                glQueryCounter(stats.softRasterQueries[2 * tileIndex], GL_TIMESTAMP);
+                const GLuint empty = 0xFFFFFFFF;
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, softRasterBuffer);
+                glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &empty);
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+                softRasterShader.use();
+                softRasterShader.setMat4("view", view);
+                softRasterShader.setMat4("projection", projection);
+                softRasterShader.setMat4("invViewProjection", glm::inverse(projection * view));
+                softRasterShader.setVec3("cameraPos", camPos);
+                softRasterShader.setVec2("viewportSize", viewportSize);
+                softRasterShader.setFloat("currentTime", currentTime);
+                softRasterShader.setFloat("softRasterThreshold", SOFT_RASTER_THRESHOLD);
+                // nearest depth of every pixel first, then the color of the splat that has it
+                for (bool colorPass : {false, true}) {
+                    softRasterShader.setBool("colorPass", colorPass);
+                    for (const PassDraws* draws : {&stillDraws, &occludedDraws, &transDraws}) {
+                        softRasterShader.setBool("isStill", draws != &transDraws);
+                        for (const auto& draw : draws->splats) {
+                            softRasterShader.setInt("firstInstance", draw.firstInstance);
+                            softRasterShader.setInt("numInstances", draw.numInstances);
+                            softRasterShader.setFloat("cubeSize", draw.cubeSize);
+                            glDispatchCompute((draw.numInstances + 63) / 64, 1, 1);
+                        }
+                    }
+                    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+                }
+
+                glBindFramebuffer(GL_FRAMEBUFFER, colorFramebuffer);
+                glEnable(GL_DEPTH_TEST);
+                softRasterMergeShader.use();
+                softRasterMergeShader.setMat4("projection", projection);
+                softRasterMergeShader.setVec2("viewportSize", viewportSize);
+                glBindVertexArray(quadVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                glQueryCounter(stats.softRasterQueries[2 * tileIndex + 1], GL_TIMESTAMP);
+            }
+
+            if (MSAA) {
+                // average the samples of every pixel into the framebuffer read by the downsample pass
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, msaaFramebuffer);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+                glBlitFramebuffer(0, 0, FB_WIDTH, FB_HEIGHT, 0, 0, FB_WIDTH, FB_HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            }
+
+            if (ACCUMULATION) {
+                accumulateShader.use();
+                accumulateShader.setInt("source", 0);
+                accumulateShader.setInt("pass", pass);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
+                glBindImageTexture(0, accumulationTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+                glDispatchCompute((FB_WIDTH + 7) / 8, (FB_HEIGHT + 7) / 8, 1);
+                glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            }
+
+            glEndQuery(GL_TIME_ELAPSED);
+            glBindVertexArray(0);
+
+            // reduces the framebuffer, or the accumulated passes, to the output resolution in one compute pass
+            auto downsample = [&](DownsampleFilter filter, unsigned int target) {
+                downsampleShader.use();
+                downsampleShader.setInt("source", 0);
+                downsampleShader.setInt("factor", settings.supersampling);
+                downsampleShader.setBool("lanczos", filter == DownsampleFilter::LANCZOS);
+                // the framebuffer pixels inside the frame, the filter does not read the ones past its edges
+                glm::ivec2 frameMin = glm::max(-glm::ivec2(tileOrigin), glm::ivec2(0)) * (int)settings.supersampling;
+                glm::ivec2 frameMax = glm::min(glm::ivec2(frameSize - tileOrigin) * (int)settings.supersampling, glm::ivec2(viewportSize));
+                downsampleShader.setIVec2("sourceMin", frameMin);
+                downsampleShader.setIVec2("sourceMax", frameMax);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, downsampleSource);
+                glBindImageTexture(0, target, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+                glDispatchCompute((TILE_OUTPUT_WIDTH + 7) / 8, (TILE_OUTPUT_HEIGHT + 7) / 8, 1);
+                glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+            };
+
+            // the accumulated passes against the SSAA reference after 1, 2, 4, ... and all passes
+            const unsigned int passes = pass + 1;
+            if (!referenceFrame.empty() && ((passes & (passes - 1)) == 0 || passes == ACCUMULATION_PASSES)) {
+                downsample(settings.downsampleFilter, accumulationBenchmarkTexture);
+                cv::Mat image(TILE_OUTPUT_HEIGHT, TILE_OUTPUT_WIDTH, CV_8UC3);
+                glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                glBindTexture(GL_TEXTURE_2D, accumulationBenchmarkTexture);
+                glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data);
+                // the tile's own pixels, flipped to the reference's row order
+                cv::Mat tilePixels;
+                cv::flip(image(cv::Rect(tileGuard, tileGuard, tile.width, tile.height)), tilePixels, 0);
+                const cv::Rect tileInFrame(tile.x, settings.outputHeight - tile.y - tile.height, tile.width, tile.height);
+                std::cout << "Accumulation benchmark: " << passes << " passes, PSNR vs ssaa "
+                          << cv::PSNR(tilePixels, referenceFrame(tileInFrame)) << " dB" << std::endl;
+            }
+            if (pass + 1 < ACCUMULATION_PASSES) continue;
+            if (transDraws.culled || occludedDraws.culled) {
+                // the statistics of the tile's last pass, kept until the frame is reported
+                glBindBuffer(GL_COPY_READ_BUFFER, cullStatsBuffer);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, stats.cullStatsBuffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, tileIndex * cullStatsBytes, cullStatsBytes);
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+                stats.culled[tileIndex] = 1;
+            }
+
+            // reduce the framebuffer to the output resolution in one compute pass
+            // -------------------------------------------------------------------
+            glDisable(GL_DEPTH_TEST);
+            glBeginQuery(GL_TIME_ELAPSED, stats.downsampleQueries[tileIndex]);
+            downsample(settings.downsampleFilter, outputTexture);
+            glEndQuery(GL_TIME_ELAPSED);
+
+            if (settings.downsampleBenchmark) {
+                // the compute filters and the former path, which mipmaps the whole framebuffer and
+                // draws it with trilinear filtering
+                vector<GLuint64> benchmarkNs(benchmarkPaths.size(), 0);
+                vector<cv::Mat> benchmarkImages;
+                for (size_t path = 0; path < benchmarkPaths.size(); ++path) {
+                    glBeginQuery(GL_TIME_ELAPSED, benchmarkQuery);
+                    if (benchmarkPaths[path] == "mipmap") {
+                        glBindFramebuffer(GL_FRAMEBUFFER, benchmarkFramebuffer);
+                        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, benchmarkTextures[path], 0);
+                        glViewport(0, 0, TILE_OUTPUT_WIDTH, TILE_OUTPUT_HEIGHT);
+                        screenShader.use();
+                        glBindVertexArray(quadVAO);
+                        glActiveTexture(GL_TEXTURE0);
+                        glBindTexture(GL_TEXTURE_2D, downsampleSource);
+                        glGenerateMipmap(GL_TEXTURE_2D);
+                        glBindSampler(0, benchmarkSampler);
+                        glDrawArrays(GL_TRIANGLES, 0, 6);
+                        glBindSampler(0, 0);
+                    } else {
+                        downsample(benchmarkPaths[path] == "lanczos" ? DownsampleFilter::LANCZOS : DownsampleFilter::BOX, benchmarkTextures[path]);
+                    }
+                    glEndQuery(GL_TIME_ELAPSED);
+                    glGetQueryObjectui64v(benchmarkQuery, GL_QUERY_RESULT, &benchmarkNs[path]);
+
+                    cv::Mat image(TILE_OUTPUT_HEIGHT, TILE_OUTPUT_WIDTH, CV_8UC3);
+                    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                    glBindTexture(GL_TEXTURE_2D, benchmarkTextures[path]);
+                    glGetTexImage(GL_TEXTURE_2D, 0, GL_BGR, GL_UNSIGNED_BYTE, image.data);
+                    benchmarkImages.push_back(image);
+                }
+                // Lanczos is the reference, it is the closest to an ideal low-pass filter
+                std::cout << "Downsample benchmark:";
+                for (size_t path = 0; path < benchmarkPaths.size(); ++path) {
+                    std::cout << " " << benchmarkPaths[path] << " " << benchmarkNs[path] * 1e-9 << " s";
+                    if (benchmarkPaths[path] != "lanczos") {
+                        std::cout << " (PSNR vs lanczos " << cv::PSNR(benchmarkImages[path], benchmarkImages[1]) << " dB)";
+                    }
+                }
+                std::cout << std::endl;
+            }
+
+            // copy the tile's own pixels into their place in the frame's pack buffer
+            if (saveFrame && YUV_READBACK) {
+                yuvShader.use();
+                yuvShader.setInt("source", 0);
+                yuvShader.setIVec2("origin", glm::ivec2(tileGuard));
+                yuvShader.setIVec2("size", glm::ivec2(tile.width, tile.height));
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, outputTexture);
+                glBindImageTexture(0, lumaTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8);
+                glBindImageTexture(1, chromaTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG8);
+                glDispatchCompute((tile.width / 2 + 7) / 8, (tile.height / 2 + 7) / 8, 1);
+                glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+                // the planes are stored top row first, so the tile's rows start counting from the top of the frame
+                const size_t width = settings.outputWidth, height = settings.outputHeight;
+                const size_t top = height - tile.y - tile.height;
+                const size_t lumaOffset = top * width + tile.x;
+                const size_t chromaOffset = width * height + top / 2 * (width / 2) + tile.x / 2;
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackSlots[framesRendered % READBACK_RING_SIZE].buffer);
+                glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                glPixelStorei(GL_PACK_ROW_LENGTH, width);
+                glGetTextureSubImage(lumaTexture, 0, 0, 0, 0, tile.width, tile.height, 1, GL_RED, GL_UNSIGNED_BYTE,
+                                     frameBytes - lumaOffset, (void*)lumaOffset);
+                glPixelStorei(GL_PACK_ROW_LENGTH, width / 2);
+                glGetTextureSubImage(chromaTexture, 0, 0, 0, 0, tile.width / 2, tile.height / 2, 1, GL_RED, GL_UNSIGNED_BYTE,
+                                     frameBytes - chromaOffset, (void*)chromaOffset);
+                glGetTextureSubImage(chromaTexture, 0, 0, 0, 0, tile.width / 2, tile.height / 2, 1, GL_GREEN, GL_UNSIGNED_BYTE,
+                                     frameBytes - chromaOffset - width * height / 4, (void*)(chromaOffset + width * height / 4));
+                glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            } else if (saveFrame) {
+                const size_t tileOffset = 3 * ((size_t)tile.y * settings.outputWidth + tile.x);
+                glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+                glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                glPixelStorei(GL_PACK_ROW_LENGTH, settings.outputWidth);
+                if (DIRECT_READBACK) {
+                    // into client memory, so no pack buffer is bound
+                    if (directPixels) {
+                        glReadPixels(tileGuard, tileGuard, tile.width, tile.height, readbackFormat, GL_UNSIGNED_BYTE,
+                                     directPixels + tileOffset);
+                    }
+                } else {
+                    glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackSlots[framesRendered % READBACK_RING_SIZE].buffer);
+                    glReadPixels(tileGuard, tileGuard, tile.width, tile.height, readbackFormat, GL_UNSIGNED_BYTE,
+                                 (void*)tileOffset);
+                    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                }
+                glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+            }
+
+            if (tiles.size() > 1) {
+                std::cout << "Tile " << tile.x << "," << tile.y << ":" << std::endl;
+            }
+            std::cout << "Planes drawn: " << numStillPlanes << " still, " << transDraws.mesh.size() << " in transition, of "
+                      << planes.size() << std::endl;
+            if (stillCubes < stillImageCubes) {
+                std::cout << "Still cubes: " << stillCubes << " from plane pyramids instead of " << stillImageCubes << std::endl;
+            }
+            if (hullTriangles > 0) {
+                std::cout << "Outline hulls: " << hullTriangles << " triangles instead of " << replacedOutlineTriangles << std::endl;
+            }
+        }
+
+        // preview of the last output tile in the window
+        // ---------------------------------------------
         glBindFramebuffer(GL_FRAMEBUFFER, 0); // back to default
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        glDisable(GL_DEPTH_TEST);
         // update the viewport size
         glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
@@ -401,8 +1992,7 @@ int main()
         glBindVertexArray(quadVAO);
 
         // draw quad
-        glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, outputTexture);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -415,23 +2005,137 @@ int main()
         double tLoop = (t1Loop - t0Loop) / cv::getTickFrequency();
         std::cout << "tLoop: " << tLoop << " s" << std::endl;
 
+        // report the GPU statistics of the frame rendered two frames ago
+        stats.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        auto& oldestStats = statsSlots[(framesRendered + 1) % READBACK_RING_SIZE];
+        if (oldestStats.frame >= 0) {
+            reportGpuStats(oldestStats, false);
+        }
+
         if (saveFrame) {
-            saveFrameBuffer(str(boost::format("frames/frame_%04d.png") % frameCount));
-            cout << currentTime << endl;
+            // the frames after this one that render the same image, up to the last frame, are not rendered
+            // but written from its pixels; the test covers the shutter of every one of them
+            int repeats = 0;
+            while ((startFrame + frameCount + repeats)/fps < maxTime) {
+                const float repeatTime = ((float) startFrame + frameCount + repeats + 1) / fps;
+                if (!timeline.isStatic(frameTime, repeatTime + SHUTTER * (ACCUMULATION_PASSES - 1) / ACCUMULATION_PASSES / fps)) break;
+                ++repeats;
+            }
+            if (DIRECT_READBACK) {
+                // already in the sink's memory
+                if (directPixels) {
+                    writeFrame(directPixels, frameCount, frameTime, repeats);
+                }
+            } else {
+                auto& slot = readbackSlots[framesRendered % READBACK_RING_SIZE];
+                slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                slot.frame = frameCount;
+                slot.time = frameTime;
+                slot.repeats = repeats;
+                // save the frame submitted two frames ago
+                auto& oldest = readbackSlots[(framesRendered + 1) % READBACK_RING_SIZE];
+                if (oldest.frame >= 0) {
+                    finishReadback(oldest);
+                }
+            }
+            frameCount += repeats;
+            framesRepeated += repeats;
             if ((startFrame + frameCount)/fps >= maxTime) break;
         }
 
         ++frameCount;
+        ++framesRendered;
+    }
+
+    // save the frames still in flight, oldest first
+    for (int i = 1; i <= READBACK_RING_SIZE; ++i) {
+        auto& stats = statsSlots[(framesRendered + i) % READBACK_RING_SIZE];
+        if (stats.frame >= 0) {
+            reportGpuStats(stats, true);
+        }
+        auto& slot = readbackSlots[(framesRendered + i) % READBACK_RING_SIZE];
+        if (slot.frame >= 0) {
+            finishReadback(slot);
+        }
+    }
+    if (framesRepeated > 0) {
+        std::cout << "Static frames: " << framesRepeated << " of " << framesSaved << " written without rendering" << std::endl;
+    }
+    if (encoder) {
+        encoder->finish();
+        std::cout << "Encoded " << encoder->framesEncoded() << " frames on " << encoder->numThreads() << " threads in "
+                  << encoder->encodeSeconds() << " s (" << 1000.0 * encoder->encodeSeconds() / std::max(1, encoder->framesEncoded())
+                  << " ms per frame), render loop waited " << encoder->waitSeconds() << " s for encoders"
+                  << std::endl;
+    }
+    if (sink) {
+        sink->finish();
+        // output volume against PNG files of the same frames, estimated from the size of one
+        size_t bytesWritten = sink->bytesWritten();
+        std::cout << "Wrote " << bytesWritten / (1024.0 * 1024.0) << " MiB to " << sink->description() << ", "
+                  << (double)bytesWritten / std::max(1, framesSaved) / 1024.0 << " KiB per frame";
+        if (pngSampleBytes > 0) {
+            const double pngBytes = (double)pngSampleBytes * framesSaved;
+            std::cout << "; as PNG files at level " << settings.pngCompression << " about " << pngBytes / (1024.0 * 1024.0)
+                      << " MiB (frame " << pngSampleFrame << " encoded to " << pngSampleBytes / 1024.0 << " KiB), "
+                      << 100.0 * bytesWritten / pngBytes << "% of that";
+        }
+        std::cout << std::endl;
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteVertexArrays(1, &quadVAO);
+    glDeleteVertexArrays(1, &impostorVAO);
+    glDeleteVertexArrays(1, &hullVAO);
+    glDeleteBuffers(1, &hullVBO);
     glDeleteBuffers(1, &vertexVBO);
+    glDeleteBuffers(1, &indexEBO);
+    glDeleteBuffers(1, &ssboStill);
+    glDeleteBuffers(1, &ssboTrans);
+    glDeleteBuffers(1, &ssboPlanes);
+    glDeleteBuffers(1, &visibleInstanceBuffer);
+    glDeleteBuffers(1, &elementsCommandBuffer);
+    glDeleteBuffers(1, &arraysCommandBuffer);
+    glDeleteBuffers(1, &cullStatsBuffer);
+    glDeleteBuffers(1, &drawCommandBuffer);
     glDeleteBuffers(1, &quadVBO);
-    glDeleteRenderbuffers(1, &rbo);
+    for (const auto& slot : readbackSlots) {
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    for (auto& slot : statsSlots) {
+        glDeleteQueries(slot.cubePassQueries.size(), slot.cubePassQueries.data());
+        glDeleteQueries(slot.downsampleQueries.size(), slot.downsampleQueries.data());
+        glDeleteQueries(slot.softRasterQueries.size(), slot.softRasterQueries.data());
+        glDeleteBuffers(1, &slot.cullStatsBuffer);
+    }
+    glDeleteQueries(1, &benchmarkQuery);
+    glDeleteSamplers(1, &benchmarkSampler);
+    glDeleteFramebuffers(1, &outputFramebuffer);
+    glDeleteTextures(1, &outputTexture);
+    glDeleteTextures(1, &lumaTexture);
+    glDeleteTextures(1, &chromaTexture);
+    glDeleteFramebuffers(1, &benchmarkFramebuffer);
+    for (auto texture : benchmarkTextures) {
+        glDeleteTextures(1, &texture);
+    }
+    glDeleteBuffers(1, &softRasterBuffer);
+    glDeleteTextures(1, &depthbuffer);
+    glDeleteTextures(1, &hiZTexture);
     glDeleteFramebuffers(1, &framebuffer);
+    glDeleteFramebuffers(1, &msaaFramebuffer);
+    glDeleteTextures(1, &msaaColorbuffer);
+    glDeleteTextures(1, &msaaDepthbuffer);
+    glDeleteTextures(1, &accumulationTexture);
+    glDeleteTextures(1, &accumulationBenchmarkTexture);
+    glDeleteFramebuffers(1, &cacheFramebuffer);
+    glDeleteTextures(1, &cacheColorbuffer);
+    glDeleteTextures(1, &cacheDepthbuffer);
+    glDeleteFramebuffers(1, &visFramebuffer);
+    glDeleteTextures(1, &visibilitybuffer);
+    glDeleteFramebuffers(1, &cacheVisFramebuffer);
+    glDeleteTextures(1, &cacheVisibilitybuffer);
 
     glfwTerminate();
     return 0;
@@ -446,32 +2150,64 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
-void saveFrameBuffer(const std::string& filename) {
-    int width = SCR_WIDTH;
-    int height = SCR_HEIGHT;
-
-    // Create a buffer to store pixel data
-    std::vector<unsigned char> pixels(3 * width * height);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // Read pixels from the OpenGL framebuffer
-    glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, pixels.data());
-
-    // Convert the pixel buffer into an OpenCV Mat
-    cv::Mat image(height, width, CV_8UC3, pixels.data());
-
-    // Flip the image vertically (OpenGL's origin is bottom-left, OpenCV's is top-left)
-    cv::flip(image, image, 0);
+// Smallest and largest size (in pixels) a unit cube of the plane can take on screen, based
+// on the farthest and nearest view-space depth of the plane's bounding box
+glm::vec2 projectedCubeSizeRange(const ChannelPlane& plane, const glm::mat4& view, const glm::mat4& projection, float viewportHeight) {
+    float minDepth = std::numeric_limits<float>::max();
+    float maxDepth = 0.0f;
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 p((corner & 1) ? plane.bboxMax.x : plane.bboxMin.x,
+                    (corner & 2) ? plane.bboxMax.y : plane.bboxMin.y,
+                    (corner & 4) ? plane.bboxMax.z : plane.bboxMin.z);
+        glm::vec4 viewPos = view * glm::vec4(p, 1.0f);
+        minDepth = std::min(minDepth, -viewPos.z);
+        maxDepth = std::max(maxDepth, -viewPos.z);
+    }
+    minDepth = std::max(minDepth, 0.1f);  // near plane
+    maxDepth = std::max(maxDepth, 0.1f);
+    float pixelsPerUnit = projection[1][1] * 0.5f * viewportHeight;
+    return glm::vec2(pixelsPerUnit / maxDepth, pixelsPerUnit / minDepth);
+}
 
-    // Save the image using OpenCV
-    if (cv::imwrite(filename, image)) {
-        std::cout << "Saved framebuffer to " << filename << std::endl;
-    } else {
-        std::cerr << "Failed to save image!" << std::endl;
+// Image size from the frame header of a JPEG file, without decoding it
+bool readJpegSize(const fs::path& path, cv::Size& size) {
+    std::ifstream file(path, std::ios::binary);
+    auto readU16 = [&file]() {
+        int high = file.get();
+        return (high << 8) | file.get();
+    };
+    if (readU16() != 0xFFD8) return false;
+    while (file) {
+        // every segment starts with 0xFF, the marker and a big-endian length that includes itself
+        if (file.get() != 0xFF) return false;
+        int marker = file.get();
+        while (marker == 0xFF) marker = file.get();
+        int length = readU16();
+        // SOF0 to SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            file.get();  // sample precision
+            size.height = readU16();
+            size.width = readU16();
+            return (bool)file;
+        }
+        file.seekg(length - 2, std::ios::cur);
     }
+    return false;
 }
 
 double randDouble() {
     return static_cast<double>(std::rand()) / RAND_MAX;
 }
+
+// Element of the Halton sequence: index written in the given base, mirrored around the radix
+// point; a low-discrepancy sequence in [0, 1)
+float halton(int index, int base) {
+    float result = 0.0f;
+    float digitWeight = 1.0f;
+    while (index > 0) {
+        digitWeight /= base;
+        result += digitWeight * (index % base);
+        index /= base;
+    }
+    return result;
+}
@@ -0,0 +1,262 @@
+#include "settings.h"
+
+#include <iostream>
+#include <sstream>
+
+static void printUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --output=WxH                 size of the saved frames (default 1920x1080)\n"
+              << "  --supersampling=N            framebuffer pixels per output pixel along each axis (default 4,\n"
+              << "                               1 or 2 with msaa, default 1)\n"
+              << "  --aa=ssaa|msaa|accumulation  supersample the framebuffer, multisample it and resolve with\n"
+              << "                               a blit, or average jittered passes (default ssaa)\n"
+              << "  --msaa-samples=4|8           samples per framebuffer pixel with msaa (default 4)\n"
+              << "  --accumulation-passes=N      jittered passes per frame with accumulation (default 16)\n"
+              << "  --shutter=F                  fraction of the frame interval the accumulation passes spread\n"
+              << "                               over, 0 to 1 (default 0, no motion blur)\n"
+              << "  --downsample=box|lanczos     filter from the framebuffer to the output (default box)\n"
+              << "  --downsample-benchmark       time every downsample path and compare their output\n"
+              << "  --accumulation-benchmark=FILE with accumulation, PSNR after 1, 2, 4, ... passes against FILE,\n"
+              << "                               the same frames rendered with --aa=ssaa --sink=raw\n"
+              << "  --tile-size=N                render the frame in tiles of NxN output pixels (default: whole frame\n"
+              << "                               if it fits the maximum texture size)\n"
+              << "  --start-frame=N              first frame rendered (default 0)\n"
+              << "  --frames=N                   frames rendered from the start frame on (default: to the end)\n"
+              << "  --visibility-buffer=on|off   shade every pixel once from a visibility buffer where it is exact\n"
+              << "                               (default on)\n"
+              << "  --settled-planes=slabs|cubes draw planes whose cubes have all arrived as ray-cast slabs or per\n"
+              << "                               cube (default slabs)\n"
+              << "  --outline-hulls=on|off       with cubes for settled planes, draw their outlines as one merged\n"
+              << "                               hull per plane (default on)\n"
+              << "  --plane-mip-threshold=PX     with cubes for settled planes, output pixels a merged cube of a\n"
+              << "                               coarser plane level may cover, 0 disables them (default 1)\n"
+              << "  --soft-raster-threshold=PX   projected cube size in framebuffer pixels below which cubes are\n"
+              << "                               splatted in a compute pass, 0 disables it (default 4)\n"
+              << "  --encoder-threads=N          threads encoding the saved frames (default: all but one)\n"
+              << "  --encoder-memory=MIB         memory of the frames queued for the encoders (default 2048)\n"
+              << "  --sink=png|video|raw|y4m|shm where the frames go: image files, a video file, a stream of\n"
+              << "                               rgb24 or YUV4MPEG2 frames, or a shared memory ring (default png)\n"
+              << "  --sink-path=PATH             directory, file or shared memory name of the sink, - for stdout\n"
+              << "                               (defaults: frames, frames.mp4, -, -, /convcubes)\n"
+              << "  --shm-timeout=S              seconds the shm sink waits for a free slot before dropping the\n"
+              << "                               remaining frames (default 60)\n"
+              << "  --video-codec=FOURCC         codec of the video file (default mp4v)\n"
+              << "  --image-format=png|qoi|ppm   file format of the png sink (default png)\n"
+              << "  --png-compression=0-9        zlib level of the PNG files (default 1)\n"
+              << "  --png-strips=N               strips of rows of one PNG deflated in parallel (default 1)\n"
+              << "  --help                       show this message" << std::endl;
+}
+
+static bool parseSize(const std::string& value, unsigned int& width, unsigned int& height)
+{
+    std::istringstream stream(value);
+    char separator = 0;
+    long w = 0, h = 0;
+    if (!(stream >> w >> separator >> h) || separator != 'x' || !stream.eof() || w <= 0 || h <= 0)
+        return false;
+    width = w;
+    height = h;
+    return true;
+}
+
+static bool parseFraction(const std::string& value, float& result)
+{
+    std::istringstream stream(value);
+    float parsed = 0.0f;
+    if (!(stream >> parsed) || !stream.eof() || parsed < 0.0f || parsed > 1.0f)
+        return false;
+    result = parsed;
+    return true;
+}
+
+static bool parseNonNegative(const std::string& value, float& result)
+{
+    std::istringstream stream(value);
+    float parsed = 0.0f;
+    if (!(stream >> parsed) || !stream.eof() || !(parsed >= 0.0f))
+        return false;
+    result = parsed;
+    return true;
+}
+
+static bool parseNonNegative(const std::string& value, unsigned int& result)
+{
+    std::istringstream stream(value);
+    long parsed = 0;
+    if (!(stream >> parsed) || !stream.eof() || parsed < 0)
+        return false;
+    result = parsed;
+    return true;
+}
+
+static bool parsePositive(const std::string& value, unsigned int& result)
+{
+    std::istringstream stream(value);
+    long parsed = 0;
+    if (!(stream >> parsed) || !stream.eof() || parsed <= 0)
+        return false;
+    result = parsed;
+    return true;
+}
+
+bool parseSettings(int argc, char** argv, Settings& settings)
+{
+    bool supersamplingGiven = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t equals = arg.find('=');
+        const std::string key = arg.substr(0, equals);
+        const std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+
+        bool valid = true;
+        if (key == "--help") {
+            printUsage(argv[0]);
+            return false;
+        } else if (key == "--output") {
+            valid = parseSize(value, settings.outputWidth, settings.outputHeight);
+        } else if (key == "--supersampling") {
+            valid = parsePositive(value, settings.supersampling);
+            supersamplingGiven = true;
+        } else if (key == "--aa") {
+            if (value == "ssaa") settings.antiAliasing = AntiAliasing::SSAA;
+            else if (value == "msaa") settings.antiAliasing = AntiAliasing::MSAA;
+            else if (value == "accumulation") settings.antiAliasing = AntiAliasing::ACCUMULATION;
+            else valid = false;
+        } else if (key == "--msaa-samples") {
+            valid = parsePositive(value, settings.msaaSamples) && (settings.msaaSamples == 4 || settings.msaaSamples == 8);
+        } else if (key == "--accumulation-passes") {
+            valid = parsePositive(value, settings.accumulationPasses);
+        } else if (key == "--shutter") {
+            valid = parseFraction(value, settings.shutter);
+        } else if (key == "--downsample") {
+            if (value == "box") settings.downsampleFilter = DownsampleFilter::BOX;
+            else if (value == "lanczos") settings.downsampleFilter = DownsampleFilter::LANCZOS;
+            else valid = false;
+        } else if (key == "--downsample-benchmark") {
+            settings.downsampleBenchmark = true;
+        } else if (key == "--accumulation-benchmark") {
+            settings.accumulationBenchmark = value;
+            valid = !value.empty();
+        } else if (key == "--start-frame") {
+            valid = parseNonNegative(value, settings.startFrame);
+        } else if (key == "--frames") {
+            valid = parsePositive(value, settings.frames);
+        } else if (key == "--visibility-buffer") {
+            if (value == "on") settings.visibilityBuffer = true;
+            else if (value == "off") settings.visibilityBuffer = false;
+            else valid = false;
+        } else if (key == "--settled-planes") {
+            if (value == "slabs") settings.settledPlanes = SettledPlanes::SLABS;
+            else if (value == "cubes") settings.settledPlanes = SettledPlanes::CUBES;
+            else valid = false;
+        } else if (key == "--outline-hulls") {
+            if (value == "on") settings.outlineHulls = true;
+            else if (value == "off") settings.outlineHulls = false;
+            else valid = false;
+        } else if (key == "--plane-mip-threshold") {
+            valid = parseNonNegative(value, settings.planeMipThreshold);
+        } else if (key == "--soft-raster-threshold") {
+            valid = parseNonNegative(value, settings.softRasterThreshold);
+        } else if (key == "--encoder-threads") {
+            valid = parsePositive(value, settings.encoderThreads);
+        } else if (key == "--encoder-memory") {
+            valid = parsePositive(value, settings.encoderMemory);
+        } else if (key == "--sink") {
+            if (value == "png") settings.sink = SinkType::PNG;
+            else if (value == "video") settings.sink = SinkType::VIDEO;
+            else if (value == "raw") settings.sink = SinkType::RAW;
+            else if (value == "y4m") settings.sink = SinkType::Y4M;
+            else if (value == "shm") settings.sink = SinkType::SHM;
+            else valid = false;
+        } else if (key == "--sink-path") {
+            settings.sinkPath = value;
+            valid = !value.empty();
+        } else if (key == "--shm-timeout") {
+            valid = parsePositive(value, settings.shmTimeout);
+        } else if (key == "--video-codec") {
+            settings.videoCodec = value;
+            valid = value.size() == 4;
+        } else if (key == "--image-format") {
+            if (value == "png") settings.imageFormat = ImageFormat::PNG;
+            else if (value == "qoi") settings.imageFormat = ImageFormat::QOI;
+            else if (value == "ppm") settings.imageFormat = ImageFormat::PPM;
+            else valid = false;
+        } else if (key == "--png-compression") {
+            // 0 is a valid level, so no parsePositive
+            valid = value.size() == 1 && value[0] >= '0' && value[0] <= '9';
+            if (valid) settings.pngCompression = value[0] - '0';
+        } else if (key == "--png-strips") {
+            valid = parsePositive(value, settings.pngStrips);
+        } else if (key == "--tile-size") {
+            valid = parsePositive(value, settings.tileSize);
+        } else {
+            std::cout << "ERROR::SETTINGS:: Unknown option " << arg << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+        if (!valid) {
+            std::cout << "ERROR::SETTINGS:: Invalid value in " << arg << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    if (!settings.accumulationBenchmark.empty() && settings.antiAliasing != AntiAliasing::ACCUMULATION) {
+        std::cout << "ERROR::SETTINGS:: --accumulation-benchmark needs --aa=accumulation" << std::endl;
+        printUsage(argv[0]);
+        return false;
+    }
+    // accumulation and multisampling render at the output resolution unless asked otherwise
+    if (settings.antiAliasing == AntiAliasing::ACCUMULATION && !supersamplingGiven) {
+        settings.supersampling = 1;
+    }
+    if (settings.antiAliasing == AntiAliasing::MSAA) {
+        if (!supersamplingGiven) {
+            settings.supersampling = 1;
+        } else if (settings.supersampling > 2) {
+            std::cout << "ERROR::SETTINGS:: --supersampling must be 1 or 2 with --aa=msaa" << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string downsampleFilterName(DownsampleFilter filter)
+{
+    return filter == DownsampleFilter::LANCZOS ? "lanczos" : "box";
+}
+
+std::string antiAliasingName(AntiAliasing antiAliasing)
+{
+    switch (antiAliasing) {
+        case AntiAliasing::MSAA: return "msaa";
+        case AntiAliasing::ACCUMULATION: return "accumulation";
+        default: return "ssaa";
+    }
+}
+
+std::string sinkTypeName(SinkType sink)
+{
+    switch (sink) {
+        case SinkType::VIDEO: return "video";
+        case SinkType::RAW: return "raw";
+        case SinkType::Y4M: return "y4m";
+        case SinkType::SHM: return "shm";
+        default: return "png";
+    }
+}
+
+std::string settledPlanesName(SettledPlanes settledPlanes)
+{
+    return settledPlanes == SettledPlanes::CUBES ? "cubes" : "slabs";
+}
+
+std::string imageFormatName(ImageFormat format)
+{
+    switch (format) {
+        case ImageFormat::QOI: return "qoi";
+        case ImageFormat::PPM: return "ppm";
+        default: return "png";
+    }
+}
@@ -0,0 +1,163 @@
+#include "shm_ring.h"
+
+#include <chrono>
+#include <climits>
+#include <new>
+#include <thread>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const uint32_t SHM_RING_MAGIC = 0x52434343;  // "CCCR"
+static const size_t SLOT_ALIGNMENT = 4096;
+
+// the counters live in memory shared between processes, so no FUTEX_PRIVATE_FLAG
+static void futexWait(std::atomic<uint32_t>* word, uint32_t expected, const timespec* timeout = nullptr)
+{
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, expected, timeout, nullptr, 0);
+}
+
+static void futexWake(std::atomic<uint32_t>* word)
+{
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free,
+              "the futex words must be plain 32-bit integers");
+
+ShmRing* ShmRing::create(const std::string& name, uint32_t width, uint32_t height, uint64_t frameBytes, uint32_t slotCount)
+{
+    const size_t headerBytes = (sizeof(ShmRingHeader) + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+    const size_t slotBytes = (sizeof(ShmSlotHeader) + frameBytes + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+    const size_t size = headerBytes + slotCount * slotBytes;
+
+    shm_unlink(name.c_str());  // left over from a run that did not finish
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return nullptr;
+    if (ftruncate(fd, size) != 0) {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    // the magic is written last, a consumer only trusts the header once it is there
+    auto* header = new (memory) ShmRingHeader();
+    header->width = width;
+    header->height = height;
+    header->slotCount = slotCount;
+    header->frameBytes = frameBytes;
+    header->slotBytes = slotBytes;
+    header->written.store(0);
+    header->read.store(0);
+    header->closed.store(0);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHM_RING_MAGIC;
+    return new ShmRing(name, memory, size, true);
+}
+
+ShmRing* ShmRing::open(const std::string& name, double timeoutSeconds)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeoutSeconds);
+    for (;;) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        struct stat status;
+        if (fd >= 0 && fstat(fd, &status) == 0 && (size_t)status.st_size >= sizeof(ShmRingHeader)) {
+            void* memory = mmap(nullptr, status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (memory == MAP_FAILED) return nullptr;
+            auto* header = (ShmRingHeader*)memory;
+            if (((volatile ShmRingHeader*)header)->magic == SHM_RING_MAGIC) {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return new ShmRing(name, memory, status.st_size, false);
+            }
+            munmap(memory, status.st_size);
+        } else if (fd >= 0) {
+            ::close(fd);
+        }
+        if (std::chrono::steady_clock::now() > deadline) return nullptr;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+ShmRing::ShmRing(const std::string& name, void* memory, size_t size, bool owner)
+    : name(name), memory(memory), size(size), owner(owner), header((ShmRingHeader*)memory)
+{
+}
+
+ShmRing::~ShmRing()
+{
+    munmap(memory, size);
+    if (owner) shm_unlink(name.c_str());
+}
+
+unsigned char* ShmRing::slot(uint32_t counter) const
+{
+    const size_t headerBytes = (sizeof(ShmRingHeader) + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+    return (unsigned char*)memory + headerBytes + (counter % header->slotCount) * header->slotBytes;
+}
+
+unsigned char* ShmRing::beginWrite(double timeoutSeconds)
+{
+    const uint32_t written = header->written.load(std::memory_order_relaxed);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeoutSeconds);
+    for (;;) {
+        uint32_t read = header->read.load(std::memory_order_acquire);
+        if (written - read < header->slotCount) break;
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) return nullptr;
+        const timespec timeout = {(time_t)(remaining / 1000000000), (long)(remaining % 1000000000)};
+        futexWait(&header->read, read, &timeout);
+    }
+    return slot(written) + sizeof(ShmSlotHeader);
+}
+
+void ShmRing::endWrite(int index, float time)
+{
+    const uint32_t written = header->written.load(std::memory_order_relaxed);
+    auto* slotHeader = (ShmSlotHeader*)slot(written);
+    slotHeader->index = index;
+    slotHeader->time = time;
+    header->written.store(written + 1, std::memory_order_release);
+    futexWake(&header->written);
+}
+
+void ShmRing::close()
+{
+    header->closed.store(1, std::memory_order_release);
+    futexWake(&header->written);
+}
+
+const unsigned char* ShmRing::beginRead(ShmSlotHeader& slotHeader)
+{
+    const uint32_t read = header->read.load(std::memory_order_relaxed);
+    for (;;) {
+        uint32_t written = header->written.load(std::memory_order_acquire);
+        if (written != read) break;
+        if (header->closed.load(std::memory_order_acquire)) {
+            // a frame may have been published right before closing
+            if (header->written.load(std::memory_order_acquire) != read) continue;
+            return nullptr;
+        }
+        // woken by endWrite and close; close does not change the futex word, so a wake between the
+        // check above and the wait is caught by the timeout
+        const timespec timeout = {0, 100000000};
+        futexWait(&header->written, written, &timeout);
+    }
+    slotHeader = *(const ShmSlotHeader*)slot(read);
+    return slot(read) + sizeof(ShmSlotHeader);
+}
+
+void ShmRing::endRead()
+{
+    header->read.fetch_add(1, std::memory_order_release);
+    futexWake(&header->read);
+}
@@ -0,0 +1,75 @@
+#include "timeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void Timeline::addStill(float time)
+{
+    // the cubes of a plane share their time, so most calls repeat the one before
+    if (!stills.empty() && stills.back() == time) return;
+    auto it = std::lower_bound(stills.begin(), stills.end(), time);
+    if (it == stills.end() || *it != time) {
+        stills.insert(it, time);
+    }
+}
+
+void Timeline::addTransition(float start, float end)
+{
+    // first interval that ends at or after start; those before it stay as they are
+    auto first = std::lower_bound(transitions.begin(), transitions.end(), start,
+                                  [](const std::pair<float, float>& interval, float time) { return interval.second < time; });
+    if (first != transitions.end() && first->first <= start && end <= first->second) return;  // already covered
+
+    // merge with every interval it overlaps
+    auto last = first;
+    while (last != transitions.end() && last->first <= end) {
+        start = std::min(start, last->first);
+        end = std::max(end, last->second);
+        ++last;
+    }
+    transitions.insert(transitions.erase(first, last), {start, end});
+}
+
+bool Timeline::isStatic(float from, float to) const
+{
+    if (to < from) std::swap(from, to);
+    // a cube appearing after from
+    auto still = std::upper_bound(stills.begin(), stills.end(), from);
+    if (still != stills.end() && *still <= to) return false;
+    // a cube moving anywhere in [from, to]
+    auto transition = std::lower_bound(transitions.begin(), transitions.end(), from,
+                                       [](const std::pair<float, float>& interval, float time) { return interval.second < time; });
+    return transition == transitions.end() || transition->first > to;
+}
+
+std::vector<StaticInterval> Timeline::staticIntervals(float from, float to) const
+{
+    // the image changes at every still time and while transitions are drawn; a transition ends
+    // after its last time, so the interval after it starts at the next float
+    std::vector<StaticInterval> intervals;
+    float start = std::numeric_limits<float>::lowest();
+    auto still = stills.begin();
+    auto addGap = [&](float gapStart, float gapEnd) {
+        // split at the still times in between
+        for (; still != stills.end() && *still < gapEnd; ++still) {
+            if (*still <= gapStart) continue;
+            intervals.push_back({gapStart, *still});
+            gapStart = *still;
+        }
+        intervals.push_back({gapStart, gapEnd});
+    };
+    for (const auto& transition : transitions) {
+        if (start < transition.first) addGap(start, transition.first);
+        start = std::nextafter(transition.second, std::numeric_limits<float>::max());
+        while (still != stills.end() && *still < start) ++still;
+    }
+    addGap(start, std::numeric_limits<float>::max());
+
+    std::vector<StaticInterval> clipped;
+    for (const auto& interval : intervals) {
+        StaticInterval part = {std::max(interval.start, from), std::min(interval.end, to)};
+        if (part.start < part.end) clipped.push_back(part);
+    }
+    return clipped;
+}
@@ -0,0 +1,108 @@
+// Benchmark of the encoder thread pool without the renderer: a render loop that hands synthetic
+// frames to FrameEncoder the way the renderer's readback does, swept over encoder thread counts.
+//
+//   encoder_benchmark [--output=WxH] [--frames=N] [--png-compression=L] [--render-ms=MS]
+//       encode N PNG frames with 1, 2, 4 and all-but-one threads and report frames per second and
+//       the time the render loop waited for a free buffer; --render-ms sleeps that long per frame
+//       in the render loop, standing in for GPU time
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_encoder.h"
+#include "image_writers.h"
+
+static void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --output=WxH                 size of the synthetic frames (default 1920x1080)\n"
+              << "  --frames=N                   frames per thread count (default 60)\n"
+              << "  --png-compression=L          zlib level of the PNG encoder, 0-9 (default 1)\n"
+              << "  --render-ms=MS               time the render loop sleeps per frame (default 0)" << std::endl;
+}
+
+// flat blocks like cubes seen from afar, a gradient, and every third block noise, which keeps the
+// deflate of a frame from being trivially fast
+static std::vector<unsigned char> syntheticFrame(int width, int height)
+{
+    std::vector<unsigned char> pixels(3 * (size_t)width * height);
+    unsigned int seed = 1;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            unsigned char* pixel = &pixels[3 * ((size_t)y * width + x)];
+            const int block = (x / 24 * 7 + y / 24 * 13) % 255;
+            seed = seed * 1103515245u + 12345u;
+            pixel[0] = block;
+            pixel[1] = (x + y) / 12;
+            pixel[2] = (x / 24 + y / 24) % 3 == 0 ? seed >> 24 : 255 - block;
+        }
+    }
+    return pixels;
+}
+
+int main(int argc, char** argv)
+{
+    int width = 1920, height = 1080, numFrames = 60, level = 1;
+    double renderMs = 0.0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t equals = arg.find('=');
+        const std::string key = arg.substr(0, equals);
+        const std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+        if (key == "--output" && sscanf(value.c_str(), "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+            // read by the sscanf
+        } else if (key == "--frames" && std::atoi(value.c_str()) > 0) {
+            numFrames = std::atoi(value.c_str());
+        } else if (key == "--png-compression" && value.size() == 1 && value[0] >= '0' && value[0] <= '9') {
+            level = value[0] - '0';
+        } else if (key == "--render-ms" && !value.empty() && std::atof(value.c_str()) >= 0.0) {
+            renderMs = std::atof(value.c_str());
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    const std::vector<unsigned char> mapped = syntheticFrame(width, height);
+    // the renderer's default is all but one hardware thread
+    const unsigned int allButOne = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    std::vector<unsigned int> threadCounts = {1, 2, 4};
+    if (std::find(threadCounts.begin(), threadCounts.end(), allButOne) == threadCounts.end()) {
+        threadCounts.push_back(allButOne);
+    }
+    std::cout << width << "x" << height << " PNG level " << level << ", " << numFrames << " frames, "
+              << renderMs << " ms render per frame, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+
+    for (unsigned int numThreads : threadCounts) {
+        std::atomic<size_t> encodedBytes{0};
+        // two buffers per thread, like the renderer without a memory limit
+        FrameEncoder encoder(mapped.size(), numThreads, 2 * numThreads, [&](const EncodeFrame& frame) {
+            std::vector<unsigned char> out;
+            encodePng(frame.pixels.data(), width, height, level, 1, out);
+            encodedBytes += out.size();
+        });
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < numFrames; ++i) {
+            if (renderMs > 0.0) {
+                std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(renderMs));
+            }
+            EncodeFrame* frame = encoder.acquire();
+            std::copy(mapped.begin(), mapped.end(), frame->pixels.begin());
+            frame->index = i;
+            encoder.submit(frame);
+        }
+        encoder.finish();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << numThreads << " threads: " << numFrames / seconds << " fps, render loop waited "
+                  << encoder.waitSeconds() << " s of " << seconds << " s, " << 1000.0 * encoder.encodeSeconds() / numFrames
+                  << " ms encode per frame, " << encodedBytes / numFrames / 1024 << " KiB per frame" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Stand-alone consumer of the renderer's shared-memory frame ring (--sink=shm), and a benchmark
+// of the ring's throughput without the renderer.
+//
+//   shm_consumer [--name=/convcubes] [--output=FILE|-]
+//       read frames in place until the renderer closes the ring, optionally writing them out
+//   shm_consumer --benchmark [--frames=N]
+//       fork a producer of synthetic 1080p, 4K and 8K frames and report frames and bytes per second,
+//       through the ring and through a pipe for comparison
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shm_ring.h"
+
+static void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --name=NAME                  shared memory object of the ring (default /convcubes)\n"
+              << "  --output=FILE|-              write every frame's pixels to a file or stdout\n"
+              << "  --benchmark                  measure the ring with a forked producer of synthetic frames\n"
+              << "  --frames=N                   frames per resolution in the benchmark (default 240)" << std::endl;
+}
+
+// every byte of the frame is value; reads all of it without stopping early, so the benchmark
+// measures a consumer that touches the whole frame
+static bool isFilled(const unsigned char* pixels, uint64_t bytes, unsigned char value)
+{
+    const uint64_t pattern = 0x0101010101010101ull * value;
+    uint64_t difference = 0;
+    uint64_t i = 0;
+    for (; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, pixels + i, sizeof(word));
+        difference |= word ^ pattern;
+    }
+    for (; i < bytes; ++i) {
+        difference |= pixels[i] ^ value;
+    }
+    return difference == 0;
+}
+
+// read until the producer closes the ring; returns the number of frames read
+static int consume(ShmRing& ring, FILE* output, bool verify)
+{
+    const ShmRingHeader& info = ring.info();
+    ShmSlotHeader slot;
+    int frames = 0;
+    while (const unsigned char* pixels = ring.beginRead(slot)) {
+        if (verify && !isFilled(pixels, info.frameBytes, (unsigned char)slot.index)) {
+            std::cerr << "Frame " << slot.index << " is corrupt" << std::endl;
+        }
+        if (output) {
+            fwrite(pixels, 1, info.frameBytes, output);
+        }
+        ring.endRead();
+        ++frames;
+    }
+    return frames;
+}
+
+// the same frames through a pipe, read whole into one reused buffer and verified
+static double pipeSeconds(uint64_t frameBytes, int numFrames)
+{
+    int fds[2];
+    if (pipe(fds) != 0) return 0.0;
+    auto start = std::chrono::steady_clock::now();
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        std::unique_ptr<unsigned char[]> frame(new unsigned char[frameBytes]);
+        for (int i = 0; i < numFrames; ++i) {
+            memset(frame.get(), (unsigned char)i, frameBytes);
+            for (uint64_t done = 0; done < frameBytes; ) {
+                ssize_t n = write(fds[1], frame.get() + done, frameBytes - done);
+                if (n <= 0) _exit(1);
+                done += n;
+            }
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    std::unique_ptr<unsigned char[]> frame(new unsigned char[frameBytes]);
+    for (int i = 0; i < numFrames; ++i) {
+        uint64_t done = 0;
+        while (done < frameBytes) {
+            ssize_t n = read(fds[0], frame.get() + done, frameBytes - done);
+            if (n <= 0) break;
+            done += n;
+        }
+        if (done < frameBytes) break;
+        // the same check as the ring's consumer, so both touch every byte
+        if (!isFilled(frame.get(), frameBytes, (unsigned char)i)) {
+            std::cerr << "Frame " << i << " through the pipe is corrupt" << std::endl;
+        }
+    }
+    close(fds[0]);
+    waitpid(child, nullptr, 0);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int benchmark(int numFrames)
+{
+    const struct { const char* name; uint32_t width, height; } sizes[] = {
+        {"1080p", 1920, 1080}, {"4K", 3840, 2160}, {"8K", 7680, 4320}};
+    const uint32_t slotCount = 4;
+    for (const auto& size : sizes) {
+        const std::string name = "/convcubes_benchmark";
+        const uint64_t frameBytes = 3ull * size.width * size.height;
+        std::unique_ptr<ShmRing> producer(ShmRing::create(name, size.width, size.height, frameBytes, slotCount));
+        if (!producer) {
+            std::cerr << "ERROR::SHM:: Failed to create " << name << std::endl;
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        pid_t child = fork();
+        if (child == 0) {
+            // producer: fill every slot completely, like the renderer copying a read back frame
+            for (int frame = 0; frame < numFrames; ++frame) {
+                unsigned char* pixels = producer->beginWrite(5.0);
+                if (!pixels) _exit(1);  // the consumer did not open the ring
+                memset(pixels, (unsigned char)frame, frameBytes);
+                producer->endWrite(frame, 0.0f);
+            }
+            producer->close();
+            _exit(0);
+        }
+        std::unique_ptr<ShmRing> consumer(ShmRing::open(name, 5.0));
+        int frames = consumer ? consume(*consumer, nullptr, true) : 0;
+        waitpid(child, nullptr, 0);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double pipeTime = pipeSeconds(frameBytes, numFrames);
+
+        std::cout << size.name << ": " << frames << " frames in " << seconds << " s, " << frames / seconds << " fps, "
+                  << frames * frameBytes / seconds / 1e9 << " GB/s (pipe " << numFrames / pipeTime << " fps, "
+                  << numFrames * frameBytes / pipeTime / 1e9 << " GB/s)" << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::string name = "/convcubes";
+    std::string outputPath;
+    bool runBenchmark = false;
+    int numFrames = 240;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t equals = arg.find('=');
+        const std::string key = arg.substr(0, equals);
+        const std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+        if (key == "--name" && !value.empty()) {
+            name = value;
+        } else if (key == "--output" && !value.empty()) {
+            outputPath = value;
+        } else if (key == "--benchmark") {
+            runBenchmark = true;
+        } else if (key == "--frames" && std::atoi(value.c_str()) > 0) {
+            numFrames = std::atoi(value.c_str());
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (runBenchmark) {
+        return benchmark(numFrames);
+    }
+
+    std::unique_ptr<ShmRing> ring(ShmRing::open(name, 60.0));
+    if (!ring) {
+        std::cerr << "ERROR::SHM:: No frame ring at " << name << std::endl;
+        return 1;
+    }
+    FILE* output = nullptr;
+    if (outputPath == "-") {
+        output = stdout;
+    } else if (!outputPath.empty()) {
+        output = fopen(outputPath.c_str(), "wb");
+    }
+
+    const ShmRingHeader& info = ring->info();
+    std::cerr << "Reading " << info.width << "x" << info.height << " frames from " << name << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    int frames = consume(*ring, output, false);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (output && output != stdout) {
+        fclose(output);
+    }
+    std::cerr << "Read " << frames << " frames in " << seconds << " s, " << frames * info.frameBytes / seconds / 1e9
+              << " GB/s" << std::endl;
+    return 0;
+}